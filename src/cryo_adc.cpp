@@ -24,9 +24,246 @@ SOFTWARE.
 
 *****************************************************************************/
 
+#include "Adafruit_ZeroDMA.h"
+
 #include "cryo_system.h"
+#include "cryo_sleep.h"
 #include "cryo_adc.h"
 
+// Arbiter shared by all instances as there is only one ADC
+ADCManager adc_manager;
+
+// DMA channel used for streaming - shared by all instances as there is only one ADC
+Adafruit_ZeroDMA adc_dma;
+bool adc_dma_allocated = false;
+DmacDescriptor* adc_dma_descriptor[2] = {NULL, NULL};
+
+// Streaming state, updated from the DMAC interrupt
+volatile bool adc_stream_active = false;
+// Set when the stream is triggered by the RTC event rather than free-running
+bool adc_stream_event = false;
+uint8_t adc_stream_event_rate = 0;
+volatile uint8_t adc_stream_half = 0;
+int16_t* adc_stream_buffer = NULL;
+uint16_t adc_stream_half_length = 0;
+ADCDifferential::stream_callback adc_stream_callback[2] = {NULL, NULL};
+// Instance that started the stream, so end() only stops its own
+ADCDifferential* adc_stream_owner = NULL;
+
+// Interrupt-driven conversion state, updated from ADC_Handler
+volatile bool adc_conversion_pending = false;
+volatile bool adc_conversion_ready = false;
+volatile int16_t adc_conversion_result = 0;
+ADCDifferential::conversion_callback adc_conversion_callback = NULL;
+
+// Window monitor state
+volatile bool adc_window_armed = false;
+bool adc_window_free_run = false;
+// Set while arm_window() has moved the ADC to the standby clock, with the 
+// prescaler it replaced
+bool adc_window_standby = false;
+uint32_t adc_window_prescaler = 0;
+ADCDifferential::window_callback adc_window_callback = NULL;
+ADCDifferential* adc_window_owner = NULL;
+
+// Calibration coefficients for one channel, keyed by INPUTCTRL (mux and gain)
+// with the voltage reference in the top four bits
+typedef struct adc_calibration_entry {
+  uint32_t key;
+  int32_t offset_microvolts;
+  // Reference correction from the bandgap at GAIN_DIV2, 32768 = 1.0.  This
+  // is not a per-gain correction: the error of the channel's own gain stage
+  // is not measured.
+  int32_t reference_q15;
+} adc_calibration_entry;
+
+typedef struct adc_calibration_table {
+  uint32_t magic;
+  uint32_t count;
+  adc_calibration_entry entries[CRYO_ADC_CALIBRATION_SLOTS];
+} adc_calibration_table;
+
+#define ADC_CALIBRATION_MAGIC 0x43414c31
+#define ADC_CALIBRATION_ROW_SIZE (FLASH_PAGE_SIZE * NVMCTRL_ROW_PAGES)
+static_assert(
+  sizeof(adc_calibration_table) <= ADC_CALIBRATION_ROW_SIZE,
+  "CRYO_ADC_CALIBRATION_SLOTS is too large for one flash row"
+);
+
+// Flash row holding the saved table - row aligned, so erasing it touches 
+// nothing else, and volatile so reads aren't folded to the initial value
+__attribute__((aligned(ADC_CALIBRATION_ROW_SIZE)))
+const volatile uint8_t adc_calibration_flash[ADC_CALIBRATION_ROW_SIZE] = {0};
+
+// Working copy of the table, loaded from flash on first use
+adc_calibration_table adc_calibration;
+bool adc_calibration_loaded = false;
+// Incremented whenever the table changes so instances recalculate their scale
+uint32_t adc_calibration_generation = 1;
+
+void ADC_Handler() {
+
+  if (adc_conversion_pending && ADC->INTFLAG.bit.RESRDY) {
+    // Reading RESULT also clears RESRDY
+    adc_conversion_result = ADC->RESULT.reg;
+    ADC->INTENCLR.reg = ADC_INTENCLR_RESRDY;
+    adc_conversion_pending = false;
+    adc_conversion_ready = true;
+    if (adc_conversion_callback != NULL)
+      adc_conversion_callback(adc_conversion_result);
+  }
+
+  if (adc_window_armed && ADC->INTFLAG.bit.WINMON) {
+    ADC->INTFLAG.reg = ADC_INTFLAG_WINMON;
+    if (adc_window_callback != NULL)
+      adc_window_callback((int16_t) ADC->RESULT.reg);
+  }
+
+}
+
+void adc_stream_dma_callback(Adafruit_ZeroDMA* dma) {
+
+  // Each descriptor covers one half of the ring buffer, so the halves
+  // complete alternately
+  uint8_t half = adc_stream_half;
+  adc_stream_half = half ^ 1;
+
+  if (adc_stream_callback[half] != NULL)
+    adc_stream_callback[half](
+      adc_stream_buffer + half * adc_stream_half_length,
+      adc_stream_half_length
+    );
+
+}
+
+bool adc_stream_dma_setup(
+  int16_t* buffer,
+  uint16_t length,
+  ADCDifferential::stream_callback half_callback,
+  ADCDifferential::stream_callback full_callback) {
+
+  // Buffer is split into two halves, one per DMA descriptor
+  if (buffer == NULL || length < 2 || (length & 1))
+    return false;
+
+  // Allocate the DMA channel on first use and trigger a beat on every result
+  if (!adc_dma_allocated) {
+    if (adc_dma.allocate() != DMA_STATUS_OK) {
+      CRYO_DEBUG_MESSAGE("ADC DMA channel allocation failed");
+      return false;
+    }
+    adc_dma.setTrigger(ADC_DMAC_ID_RESRDY);
+    adc_dma.setAction(DMA_TRIGGER_ACTON_BEAT);
+    adc_dma.setCallback(adc_stream_dma_callback, DMA_CALLBACK_TRANSFER_DONE);
+    adc_dma_allocated = true;
+  }
+
+  adc_stream_buffer = buffer;
+  adc_stream_half_length = length / 2;
+  adc_stream_half = 0;
+  adc_stream_callback[0] = half_callback;
+  adc_stream_callback[1] = full_callback;
+
+  for (uint8_t k = 0; k < 2; k++) {
+    int16_t* destination = buffer + k * adc_stream_half_length;
+    if (adc_dma_descriptor[k] == NULL) {
+      adc_dma_descriptor[k] = adc_dma.addDescriptor(
+        (void*) &ADC->RESULT.reg,
+        destination,
+        adc_stream_half_length,
+        DMA_BEAT_SIZE_HWORD,
+        false,  // always read from RESULT
+        true    // step through the buffer
+      );
+      if (adc_dma_descriptor[k] == NULL) {
+        CRYO_DEBUG_MESSAGE("ADC DMA descriptor allocation failed");
+        return false;
+      }
+    } else {
+      adc_dma.changeDescriptor(
+        adc_dma_descriptor[k],
+        (void*) &ADC->RESULT.reg,
+        destination,
+        adc_stream_half_length
+      );
+    }
+    // Interrupt at the end of each half, not just at the end of the ring
+    adc_dma_descriptor[k]->BTCTRL.bit.BLOCKACT = DMA_BLOCK_ACTION_INT;
+  }
+  // Link the second half back to the first to form the ring
+  adc_dma.loop(true);
+
+  return true;
+
+}
+
+void adc_calibration_load() {
+
+  uint8_t* table = (uint8_t*) &adc_calibration;
+  for (uint32_t k = 0; k < sizeof(adc_calibration); k++)
+    table[k] = adc_calibration_flash[k];
+
+  // Erased (or never written) flash doesn't carry the magic number
+  if (adc_calibration.magic != ADC_CALIBRATION_MAGIC || adc_calibration.count > CRYO_ADC_CALIBRATION_SLOTS) {
+    memset(&adc_calibration, 0, sizeof(adc_calibration));
+    adc_calibration.magic = ADC_CALIBRATION_MAGIC;
+  }
+
+  adc_calibration_loaded = true;
+  adc_calibration_generation++;
+
+}
+
+adc_calibration_entry* adc_calibration_find(uint32_t key) {
+
+  if (!adc_calibration_loaded)
+    adc_calibration_load();
+
+  for (uint32_t k = 0; k < adc_calibration.count; k++) {
+    if (adc_calibration.entries[k].key == key)
+      return &adc_calibration.entries[k];
+  }
+  return NULL;
+
+}
+
+void adc_calibration_flash_write() {
+
+  const uint32_t* source = (const uint32_t*) &adc_calibration;
+  volatile uint32_t* destination = (volatile uint32_t*) adc_calibration_flash;
+  uint32_t words = (sizeof(adc_calibration) + 3) / 4;
+
+  // Manual page writes, so each page is only committed by the WP command,
+  // restoring the core's setting once done
+  uint32_t ctrlb = NVMCTRL->CTRLB.reg;
+  NVMCTRL->CTRLB.bit.MANW = 1;
+  NVMCTRL->STATUS.reg = NVMCTRL_STATUS_MASK;
+
+  // Erase the row (ADDR is in 16-bit words)
+  NVMCTRL->ADDR.reg = (uintptr_t) adc_calibration_flash / 2;
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+  while (!NVMCTRL->INTFLAG.bit.READY);
+
+  for (uint32_t k = 0; k < words; ) {
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+    while (!NVMCTRL->INTFLAG.bit.READY);
+    // Writing the page buffer also latches ADDR for the page write
+    do {
+      destination[k] = source[k];
+      k++;
+    } while (k < words && k % (FLASH_PAGE_SIZE / 4) != 0);
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+    while (!NVMCTRL->INTFLAG.bit.READY);
+  }
+
+  NVMCTRL->CTRLB.reg = ctrlb;
+
+  // Drop any cached lines of the old row so reading it back sees the new table
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_INVALL;
+  while (!NVMCTRL->INTFLAG.bit.READY);
+
+}
+
 ADCDifferential::ADCDifferential(
   ADCDifferential::INPUT_PIN_POS input_pos,
   ADCDifferential::INPUT_PIN_NEG input_neg,
@@ -42,44 +279,105 @@ ADCDifferential::ADCDifferential(
   this->averages = averages;
   this->resolution = resolution;
   this->reference = reference;
+  this->prescaler = ADCDifferential::PRESCALER::PRESCALER_DIV512;
+  this->sample_length = 0;
+  this->conversion_complete_callback = NULL;
+  this->autorange_last = 0;
+  this->autorange_valid = false;
+  this->registered = false;
+  this->microvolt_scale = 0;
+  this->microvolt_shift = 0;
+  this->microvolt_offset = 0;
+  this->microvolt_generation = 0;
 
 }
 
 ADCDifferential::~ADCDifferential() {
-  this->disable();
+  this->end();
 }
 
 void ADCDifferential::begin() {
   
-  // Generic clock init
+  // The clock and ADC are only initialised by the first instance to begin
+  if (!this->registered) {
+    adc_manager.acquire();
+    this->registered = true;
+    CRYO_DEBUG_MESSAGE("ADC acquired");
+  }
+  
+  // Write the configuration in one transaction
+  this->activate();
+  CRYO_DEBUG_MESSAGE("ADC configured");
+  
+}
+
+void ADCDifferential::end() {
+
+  if (!this->registered)
+    return;
+
+  if (adc_window_owner == this)
+    this->disarm_window();
+  if (adc_stream_owner == this)
+    this->stop_stream();
+
+  this->registered = false;
+  adc_manager.release();
+
+}
+
+void ADCDifferential::activate() {
+
+  if (this->registered)
+    adc_manager.apply(this->get_config());
+
+}
+
+ADCManager* cryo_get_adc_manager() {
+  return &adc_manager;
+}
+
+ADCManager::ADCManager() {
+
+  this->users = 0;
+  this->active_valid = false;
+  this->inputs_selected = false;
+
+}
+
+void ADCManager::acquire() {
+
+  if (this->users++ > 0)
+    return;
+
   this->generic_clock_init();
   CRYO_DEBUG_MESSAGE("Clock init");
-  // ADC init
-  this->disable();
-  CRYO_DEBUG_MESSAGE("ADC disabled");
   this->adc_init();
   CRYO_DEBUG_MESSAGE("ADC initialied");
-  
-  CRYO_DEBUG_MESSAGE("Setting input pins");
-  this->set_input_pins(this->input_pos, this->input_neg);  
-  CRYO_DEBUG_MESSAGE("Input pins done");
-  
-  this->set_gain(this->gain);  
-  CRYO_DEBUG_MESSAGE("Gain done");
-  
-  this->set_resolution(this->resolution);
-  CRYO_DEBUG_MESSAGE("Resolution done");
-  
-  this->set_voltage_reference(this->reference);
-  CRYO_DEBUG_MESSAGE("Voltage reference done");
-  
-  
-  this->set_averages(this->averages);
-  CRYO_DEBUG_MESSAGE("ADC configured");
-  
+
+}
+
+void ADCManager::release() {
+
+  if (this->users == 0)
+    return;
+  if (--this->users == 0)
+    this->power_down();
+
+}
+
+uint8_t ADCManager::get_users() {
+  return this->users;
 }
 
-void ADCDifferential::generic_clock_init() {
+void ADCManager::invalidate() {
+  this->active_valid = false;
+}
+
+void ADCManager::generic_clock_init() {
+  
+  // Bus clock may have been gated by power_down()
+  PM->APBCMASK.reg |= PM_APBCMASK_ADC;
     
   // Step 1 - Configure Generic Clock Generator (GCLK_ADC)
   // Unless we want to reduce the conversion rate, we can leave GENDIV alone
@@ -106,26 +404,30 @@ void ADCDifferential::generic_clock_init() {
 
 }
 
-void ADCDifferential::adc_init() {
+void ADCManager::adc_init() {
 
+  ADC->CTRLA.reg = ADC->CTRLA.reg & ~ADC_CTRLA_ENABLE;
+  while (ADC->STATUS.bit.SYNCBUSY);
   ADC->CTRLA.reg = ADC_CTRLA_SWRST;
-  this->wait_for_sync();
+  while (ADC->STATUS.bit.SYNCBUSY);
+  // Registers are back at their reset values
+  this->active_valid = false;
   
   // // Step 3 - Configure Differential Mode
   // //   this will resolve the voltage between MUXPOS and MUXNEG
   ADC->CTRLB.reg = 
     // set 12-bit resolution
-    // divide clock by 512 (8 MHz / 512 = 15.62 kHz)
+    // divide clock by 512 (48 MHz / 512 = 93.75 kHz) until configured
     ADC_CTRLB_PRESCALER_DIV512 |
     // and enable differential mode
     ADC_CTRLB_DIFFMODE;
-  this->wait_for_sync();
+  while (ADC->STATUS.bit.SYNCBUSY);
 
   // Set sampling time 
   //    JH: need to play around here with effect on ADC input impedance/accuracy
     ADC->SAMPCTRL.reg = 
     ADC_SAMPCTRL_MASK & 0; // 0xff;
-  this->wait_for_sync();
+  while (ADC->STATUS.bit.SYNCBUSY);
 
   // Step 6 - Read NVM calibration values
   // - ref: https://blog.thea.codes/reading-analog-values-with-the-samd-adc/
@@ -140,93 +442,74 @@ void ADCDifferential::adc_init() {
 
 }
 
-void ADCDifferential::set_input_pins(ADCDifferential::INPUT_PIN_POS input_pos, ADCDifferential::INPUT_PIN_NEG input_neg) {
+void ADCManager::power_down() {
 
+  // Let an interrupt-driven conversion finish before stopping the clock
+  while (adc_conversion_pending) {}
 
-  CRYO_DEBUG_MESSAGE("Disabling ADC");
-  bool enabled = this->is_enabled();
-  if (enabled)
-    this->disable();
+  ADC->CTRLA.reg = ADC->CTRLA.reg & ~ADC_CTRLA_ENABLE;
+  while (ADC->STATUS.bit.SYNCBUSY);
 
+  // Gate the generic clock (CLKEN = 0) and then the bus clock
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_ADC;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  PM->APBCMASK.reg &= ~PM_APBCMASK_ADC;
 
-  CRYO_DEBUG_MESSAGE("Setting pin direction");
-    // Assign port direction registers
-  this->input_pin_direction(input_pos);
-  this->input_pin_direction(input_neg);
-  
-  CRYO_DEBUG_MESSAGE("Assigning register");
-    ADC->INPUTCTRL.reg = (ADC->INPUTCTRL.reg & ~(ADC_INPUTCTRL_MUXPOS_Msk | ADC_INPUTCTRL_MUXNEG_Msk)) 
-    | (uint32_t)input_pos | (uint32_t)input_neg;
-  this->wait_for_sync();
+  // Registers are re-initialised by the next acquire()
+  this->active_valid = false;
+  this->inputs_selected = false;
 
-  CRYO_DEBUG_MESSAGE("Waiting for sync");
-  
-  if (enabled)
-    this->enable();
+}
+
+void ADCDifferential::set_input_pins(ADCDifferential::INPUT_PIN_POS input_pos, ADCDifferential::INPUT_PIN_NEG input_neg) {
+
+  ADCDifferential::config cfg = this->get_config();
+  cfg.input_pos = input_pos;
+  cfg.input_neg = input_neg;
+  this->configure(cfg);
 
 }
 
 void ADCDifferential::input_pin_direction(ADCDifferential::INPUT_PIN_POS input_pos) {
 
-  // JH: moved from switch statement to if/else - stopped bug where multiple pin directions were being set
-
-  if (input_pos == INPUT_PIN_POS::A0_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA02, 2, 1, PORT_PMUX_PMUXE_A);
-  else if (input_pos == INPUT_PIN_POS::A1_PIN)
-      this->input_pin_direction_register_set(GROUP_1, PORT_PB08, 8, 4, PORT_PMUX_PMUXE_B);
-  else if (input_pos == INPUT_PIN_POS::A2_PIN)
-      this->input_pin_direction_register_set(GROUP_1, PORT_PB08, 9, 4, PORT_PMUX_PMUXO_B);
-  else if (input_pos == INPUT_PIN_POS::A3_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA04, 4, 2, PORT_PMUX_PMUXE_A);
-  else if (input_pos == INPUT_PIN_POS::A4_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA05, 5, 2, PORT_PMUX_PMUXO_A);
-  else if (input_pos == INPUT_PIN_POS::A5_PIN)
-      this->input_pin_direction_register_set(GROUP_1, PORT_PB02, 2, 1, PORT_PMUX_PMUXE_B);
-  else if (input_pos == INPUT_PIN_POS::D0_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA11, 11, 5, PORT_PMUX_PMUXO_A);
-  else if (input_pos == INPUT_PIN_POS::D1_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA10, 10, 5, PORT_PMUX_PMUXE_A);
-  else if (input_pos == INPUT_PIN_POS::D9_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA07, 7, 3, PORT_PMUX_PMUXO_A);
-  
-  return; // don't need to do anything
+  ADCDifferential::input_pin_direction_register_set(
+    cryo_adc_pin_mux_for((uint32_t) input_pos >> ADC_INPUTCTRL_MUXPOS_Pos)
+  );
 
 }
 
 void ADCDifferential::input_pin_direction(ADCDifferential::INPUT_PIN_NEG input_neg) {
-  
-  // JH: moved from switch statement to if/else - stopped bug where multiple pin directions were being set
-
-  if (input_neg == INPUT_PIN_NEG::A0_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA02, 2, 1, PORT_PMUX_PMUXE_A);
-  else if (input_neg == INPUT_PIN_NEG::A1_PIN)
-      this->input_pin_direction_register_set(GROUP_1, PORT_PB08, 8, 4, PORT_PMUX_PMUXE_B);
-  else if (input_neg == INPUT_PIN_NEG::A2_PIN)
-      this->input_pin_direction_register_set(GROUP_1, PORT_PB08, 9, 4, PORT_PMUX_PMUXO_B);
-  else if (input_neg == INPUT_PIN_NEG::A3_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA04, 4, 2, PORT_PMUX_PMUXE_A);
-  else if (input_neg == INPUT_PIN_NEG::A4_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA05, 5, 2, PORT_PMUX_PMUXO_A);
-  else if (input_neg == INPUT_PIN_NEG::D9_PIN)
-      this->input_pin_direction_register_set(GROUP_0, PORT_PA07, 7, 3, PORT_PMUX_PMUXO_A);
-
-  return; // don't need to do anything
-
-}
-
-void ADCDifferential::input_pin_direction_register_set(
-  uint8_t group,
-  uint32_t dirclr,
-  uint16_t pincfg,
-  uint16_t pmux,
-  uint8_t pmuxreg) {
-
-  CRYO_DEBUG_MESSAGE("Setting pin direction (register level)");
-  PORT->Group[group].DIRCLR.reg = dirclr; // DIRCLR for input, DIRSET for output
-  PORT->Group[group].PINCFG[pincfg].reg |= PORT_PINCFG_PMUXEN;
-  PORT->Group[group].PMUX[pmux].reg = pmuxreg;
-  this->wait_for_sync();
-  CRYO_DEBUG_MESSAGE("Setting pin direction (finished waiting)");
+
+  ADCDifferential::input_pin_direction_register_set(
+    cryo_adc_pin_mux_for((uint32_t) input_neg >> ADC_INPUTCTRL_MUXNEG_Pos)
+  );
+
+}
+
+void ADCDifferential::input_pin_direction_register_set(cryo_adc_pin_mux mux) {
+
+  // Internal inputs don't need a pin
+  if (mux.group == GROUP_NONE)
+    return;
+
+  PortGroup* port = &PORT->Group[mux.group];
+  port->DIRCLR.reg = 1ul << mux.pin; // DIRCLR for input, DIRSET for output
+  port->PINCFG[mux.pin].reg |= PORT_PINCFG_PMUXEN;
+  // Select peripheral function B (analogue) in the odd or even half of PMUX, 
+  // leaving the neighbouring pin alone
+  if (mux.pin & 1)
+    port->PMUX[mux.pin >> 1].reg = (port->PMUX[mux.pin >> 1].reg & ~PORT_PMUX_PMUXO_Msk) | PORT_PMUX_PMUXO_B;
+  else
+    port->PMUX[mux.pin >> 1].reg = (port->PMUX[mux.pin >> 1].reg & ~PORT_PMUX_PMUXE_Msk) | PORT_PMUX_PMUXE_B;
+
+}
+
+void ADCDifferential::select_inputs(
+  cryo_adc_pin_mux pos,
+  cryo_adc_pin_mux neg,
+  uint32_t inputctrl) {
+
+  adc_manager.apply_inputs(pos, neg, inputctrl);
 
 }
 
@@ -259,17 +542,9 @@ void ADCDifferential::wait_for_sync() {
 
 void ADCDifferential::set_gain(ADCDifferential::GAIN gain) {
 
-  // Store enabled state
-  bool enabled = this->is_enabled();
-  if (enabled)
-    this->disable();
-
-  // Clear existing gain setting, then OR with new one
-  ADC->INPUTCTRL.reg = (ADC->INPUTCTRL.reg & ~ADC_INPUTCTRL_GAIN_Msk) | gain;
-  this->wait_for_sync();
-
-  // Re-enable if necessary
-  if (enabled) this->enable();
+  ADCDifferential::config cfg = this->get_config();
+  cfg.gain = gain;
+  this->configure(cfg);
 
 }
 
@@ -283,51 +558,224 @@ void ADCDifferential::set_gain(float_t gain_numeric) {
 
 void ADCDifferential::set_voltage_reference(ADCDifferential::VOLTAGE_REFERENCE reference) {
 
-  // Store enabled state
-  bool enabled = this->is_enabled();
-  if (enabled)
-    this->disable();
-    
-  // Clear existing voltage reference, then OR with new one
-  ADC->REFCTRL.reg =(ADC->REFCTRL.reg & ~ADC_REFCTRL_REFSEL_Msk) | ADC_REFCTRL_REFCOMP | reference;
-  this->wait_for_sync();
-
-  // Re-enable if necessary
-  if (enabled) this->enable();
+  ADCDifferential::config cfg = this->get_config();
+  cfg.reference = reference;
+  this->configure(cfg);
 
 }
 
 void ADCDifferential::set_resolution(ADCDifferential::RESOLUTION res) {
 
-  // Store enabled state
-  bool enabled = this->is_enabled();
-  if (enabled)
-    this->disable();
-    
-  // Clear existing voltage reference, then OR with new one
-  ADC->CTRLB.reg =(ADC->CTRLB.reg & ~ADC_CTRLB_RESSEL_Msk) | res;
-  this->wait_for_sync();
-
-  // Re-enable if necessary
-  if (enabled) this->enable();
+  ADCDifferential::config cfg = this->get_config();
+  cfg.resolution = res;
+  this->configure(cfg);
 
 }
 
 void ADCDifferential::set_averages(ADCDifferential::AVERAGES averages) {
 
-  bool enabled = this->is_enabled();
-  if (enabled)
-    this->disable();
+  ADCDifferential::config cfg = this->get_config();
+  cfg.averages = averages;
+  this->configure(cfg);
 
-    ADC->AVGCTRL.reg = (ADC->AVGCTRL.reg & ~ADC_AVGCTRL_SAMPLENUM_Msk) | averages;
-    this->wait_for_sync();
+}
 
-  if (enabled) this->enable();
+void ADCDifferential::set_prescaler(ADCDifferential::PRESCALER prescaler) {
+
+  ADCDifferential::config cfg = this->get_config();
+  cfg.prescaler = prescaler;
+  this->configure(cfg);
+
+}
+
+void ADCDifferential::set_sample_length(uint8_t sample_length) {
+
+  ADCDifferential::config cfg = this->get_config();
+  cfg.sample_length = sample_length & ADC_SAMPCTRL_SAMPLEN_Msk;
+  this->configure(cfg);
+
+}
+
+void ADCDifferential::set_timing_profile(ADCDifferential::TIMING_PROFILE profile) {
+
+  ADCDifferential::config cfg = this->get_config();
+
+  switch (profile) {
+    case TIMING_FAST:
+      // 48 MHz / 32 = 1.5 MHz, half cycle sampling
+      cfg.prescaler = PRESCALER_DIV32;
+      cfg.sample_length = 0;
+      cfg.averages = AVG_X16;
+      break;
+    case TIMING_BALANCED:
+      // 48 MHz / 64 = 750 kHz, 2 cycle sampling
+      cfg.prescaler = PRESCALER_DIV64;
+      cfg.sample_length = 3;
+      cfg.averages = AVG_X64;
+      break;
+    case TIMING_PRECISE:
+      // 48 MHz / 256 = 187.5 kHz, 8 cycle sampling
+      cfg.prescaler = PRESCALER_DIV256;
+      cfg.sample_length = 15;
+      cfg.averages = AVG_X1024;
+      break;
+  }
+
+  this->configure(cfg);
+
+}
+
+void ADCDifferential::configure(const ADCDifferential::config& cfg) {
+
+  this->input_pos = cfg.input_pos;
+  this->input_neg = cfg.input_neg;
+  this->gain = cfg.gain;
+  this->averages = cfg.averages;
+  this->resolution = cfg.resolution;
+  this->reference = cfg.reference;
+  this->prescaler = cfg.prescaler;
+  this->sample_length = cfg.sample_length;
+  // Force the microvolt scale to be recalculated
+  this->microvolt_generation = 0;
+
+  // Reconfiguring an instance replaces any channel chosen by AdcChannel::select()
+  adc_manager.clear_selection();
+  this->activate();
+
+}
+
+void ADCManager::apply(const ADCDifferential::config& requested) {
+
+  // Keep the channel chosen by AdcChannel::select(), which would otherwise be 
+  // undone by the next read() of whichever instance does the conversion
+  ADCDifferential::config cfg = requested;
+  if (this->inputs_selected) {
+    cfg.input_pos = this->active.input_pos;
+    cfg.input_neg = this->active.input_neg;
+    cfg.gain = this->active.gain;
+  }
+
+  // Compare against what was last written so only registers that differ are touched
+  bool write_pins = !this->active_valid 
+    || cfg.input_pos != this->active.input_pos 
+    || cfg.input_neg != this->active.input_neg;
+  bool write_inputctrl = write_pins || cfg.gain != this->active.gain;
+  bool write_ctrlb = !this->active_valid 
+    || cfg.resolution != this->active.resolution 
+    || cfg.prescaler != this->active.prescaler;
+  bool write_sampctrl = !this->active_valid || cfg.sample_length != this->active.sample_length;
+  bool write_refctrl = !this->active_valid || cfg.reference != this->active.reference;
+  bool write_avgctrl = !this->active_valid || cfg.averages != this->active.averages;
+
+  if (!(write_inputctrl || write_ctrlb || write_sampctrl || write_refctrl || write_avgctrl))
+    return;
+
+  // INPUTCTRL can be written while enabled, so switching between instances
+  // on the same settings avoids the disable/enable cycle
+  bool enabled = (write_ctrlb || write_sampctrl || write_refctrl || write_avgctrl)
+    && ADC->CTRLA.bit.ENABLE;
+  if (enabled) {
+    ADC->CTRLA.reg = ADC->CTRLA.reg & ~ADC_CTRLA_ENABLE;
+    while (ADC->STATUS.bit.SYNCBUSY);
+  }
+
+  if (write_pins) {
+    // Assign port direction registers
+    ADCDifferential::input_pin_direction_register_set(
+      cryo_adc_pin_mux_for((uint32_t) cfg.input_pos >> ADC_INPUTCTRL_MUXPOS_Pos)
+    );
+    ADCDifferential::input_pin_direction_register_set(
+      cryo_adc_pin_mux_for((uint32_t) cfg.input_neg >> ADC_INPUTCTRL_MUXNEG_Pos)
+    );
+  }
+
+  // REFCTRL, AVGCTRL and SAMPCTRL are not write-synchronised
+  if (write_refctrl)
+    ADC->REFCTRL.reg = (ADC->REFCTRL.reg & ~ADC_REFCTRL_REFSEL_Msk) | ADC_REFCTRL_REFCOMP | cfg.reference;
+  if (write_avgctrl)
+    ADC->AVGCTRL.reg = (ADC->AVGCTRL.reg & ~ADC_AVGCTRL_SAMPLENUM_Msk) | cfg.averages;
+  if (write_sampctrl)
+    ADC->SAMPCTRL.reg = ADC_SAMPCTRL_SAMPLEN(cfg.sample_length);
+
+  // Back-to-back synchronised writes stall the bus until the previous write 
+  // has synchronised, so a single wait at the end is sufficient
+  if (write_inputctrl)
+    ADC->INPUTCTRL.reg = (ADC->INPUTCTRL.reg & ~(ADC_INPUTCTRL_MUXPOS_Msk | ADC_INPUTCTRL_MUXNEG_Msk | ADC_INPUTCTRL_GAIN_Msk))
+      | (uint32_t) cfg.input_pos | (uint32_t) cfg.input_neg | cfg.gain;
+  if (write_ctrlb)
+    ADC->CTRLB.reg = (ADC->CTRLB.reg & ~(ADC_CTRLB_RESSEL_Msk | ADC_CTRLB_PRESCALER_Msk)) 
+      | cfg.resolution | cfg.prescaler;
+  while (ADC->STATUS.bit.SYNCBUSY);
+
+  if (enabled) {
+    ADC->CTRLA.reg = ADC->CTRLA.reg | ADC_CTRLA_ENABLE;
+    while (ADC->STATUS.bit.SYNCBUSY);
+  }
+
+  this->active = cfg;
+  this->active_valid = true;
+
+}
+
+void ADCManager::apply_inputs(
+  cryo_adc_pin_mux pos,
+  cryo_adc_pin_mux neg,
+  uint32_t inputctrl) {
+
+  ADCDifferential::INPUT_PIN_POS input_pos = (ADCDifferential::INPUT_PIN_POS) (inputctrl & ADC_INPUTCTRL_MUXPOS_Msk);
+  ADCDifferential::INPUT_PIN_NEG input_neg = (ADCDifferential::INPUT_PIN_NEG) (inputctrl & ADC_INPUTCTRL_MUXNEG_Msk);
+  ADCDifferential::GAIN gain = (ADCDifferential::GAIN) (inputctrl & ADC_INPUTCTRL_GAIN_Msk);
+
+  this->inputs_selected = true;
+
+  // Nothing to do if the ADC is already on this channel
+  if (this->active_valid 
+    && this->active.input_pos == input_pos 
+    && this->active.input_neg == input_neg 
+    && this->active.gain == gain)
+    return;
+
+  ADCDifferential::input_pin_direction_register_set(pos);
+  ADCDifferential::input_pin_direction_register_set(neg);
+
+  // INPUTCTRL is not enable-protected, so no disable/enable cycle is needed
+  ADC->INPUTCTRL.reg = (ADC->INPUTCTRL.reg & ~(ADC_INPUTCTRL_MUXPOS_Msk | ADC_INPUTCTRL_MUXNEG_Msk | ADC_INPUTCTRL_GAIN_Msk)) 
+    | inputctrl;
+  while (ADC->STATUS.bit.SYNCBUSY);
+
+  this->active.input_pos = input_pos;
+  this->active.input_neg = input_neg;
+  this->active.gain = gain;
+
+}
+
+void ADCManager::clear_selection() {
+  this->inputs_selected = false;
+}
+
+ADCDifferential::config ADCDifferential::get_config() {
+
+  ADCDifferential::config cfg;
+  cfg.input_pos = this->input_pos;
+  cfg.input_neg = this->input_neg;
+  cfg.gain = this->gain;
+  cfg.averages = this->averages;
+  cfg.resolution = this->resolution;
+  cfg.reference = this->reference;
+  cfg.prescaler = this->prescaler;
+  cfg.sample_length = this->sample_length;
+  return cfg;
 
 }
 
 int16_t ADCDifferential::read() {
   
+  // Let any interrupt-driven conversion finish, otherwise the interrupt
+  // would consume the RESRDY flag polled below
+  while (adc_conversion_pending) {}
+
+  this->activate();
+
   // Read ADC value
   int16_t adc_conversion;
   // - Trigger conversion
@@ -344,6 +792,671 @@ int16_t ADCDifferential::read() {
 
 }
 
+// Multiplier converting a result at the given gain to GAIN_16X counts
+int32_t adc_gain_to_16x(ADCDifferential::GAIN gain) {
+  switch (gain) {
+    case ADCDifferential::GAIN::GAIN_DIV2: return 32;
+    case ADCDifferential::GAIN::GAIN_1X: return 16;
+    case ADCDifferential::GAIN::GAIN_2X: return 8;
+    case ADCDifferential::GAIN::GAIN_4X: return 4;
+    case ADCDifferential::GAIN::GAIN_8X: return 2;
+    default: return 1;
+  }
+}
+
+uint8_t ADCDifferential::convert_enum_to_gain_x2(ADCDifferential::GAIN gain) {
+  return 32 / adc_gain_to_16x(gain);
+}
+
+uint32_t ADCDifferential::reference_microvolts(ADCDifferential::VOLTAGE_REFERENCE reference) {
+
+  switch (reference) {
+    case INT1V_INTERNAL: return 1000000;
+    // INTVCC0 is VDDANA / 1.48
+    case INTVCC0_INTERNAL: return (uint32_t) ((uint64_t) CRYO_ADC_VDD_MICROVOLTS * 100 / 148);
+    case INTVCC1_INTERNAL: return CRYO_ADC_VDD_MICROVOLTS / 2;
+    default: return CRYO_ADC_AREF_MICROVOLTS;
+  }
+
+}
+
+int32_t ADCDifferential::full_scale_counts(
+  ADCDifferential::RESOLUTION resolution,
+  ADCDifferential::AVERAGES averages) {
+
+  if (resolution == RES_8BIT)
+    return 128;
+  if (resolution == RES_10BIT)
+    return 512;
+  if (resolution == RES_12BIT)
+    return 2048;
+
+  // Averaged results accumulate up to 16 samples, beyond which the ADC
+  // shifts the result to keep it within 16 bits (see 33.6.7)
+  uint32_t samples = 1ul << (averages >> ADC_AVGCTRL_SAMPLENUM_Pos);
+  return 2048 * (samples < 16 ? samples : 16);
+
+}
+
+int32_t ADCDifferential::read_autorange(ADCDifferential::GAIN* gain_used) {
+
+  ADCDifferential::config cfg = this->get_config();
+  int32_t full_scale = ADCDifferential::full_scale_counts(cfg.resolution, cfg.averages);
+
+  if (!this->autorange_valid) {
+    this->autorange_last = this->autorange_probe();
+    this->autorange_valid = true;
+  }
+
+  cfg.gain = this->autorange_select_gain(this->autorange_last);
+  this->configure(cfg);
+  int16_t result = this->read();
+
+  // Close to clipping means the signal has moved since the last result, so
+  // probe again and re-read once
+  int32_t magnitude = result < 0 ? -(int32_t) result : result;
+  if (magnitude > full_scale - full_scale / 16 && cfg.gain != GAIN_DIV2) {
+    cfg.gain = this->autorange_select_gain(this->autorange_probe());
+    this->configure(cfg);
+    result = this->read();
+  }
+
+  this->autorange_last = (int32_t) result * adc_gain_to_16x(cfg.gain);
+  if (gain_used != NULL)
+    *gain_used = cfg.gain;
+
+  return this->autorange_last;
+
+}
+
+int32_t ADCDifferential::autorange_probe() {
+
+  ADCDifferential::config cfg = this->get_config();
+  ADCDifferential::config probe = cfg;
+  probe.gain = GAIN_DIV2;
+  probe.averages = AVG_X4;
+  this->configure(probe);
+  int16_t result = this->read();
+  this->configure(cfg);
+
+  // Scale to GAIN_16X counts at the configured resolution and averaging
+  int32_t probe_full_scale = ADCDifferential::full_scale_counts(probe.resolution, probe.averages);
+  int32_t full_scale = ADCDifferential::full_scale_counts(cfg.resolution, cfg.averages);
+  return ((int32_t) result * full_scale / probe_full_scale) * adc_gain_to_16x(GAIN_DIV2);
+
+}
+
+ADCDifferential::GAIN ADCDifferential::autorange_select_gain(int32_t normalised) {
+
+  const ADCDifferential::GAIN gains[] = {
+    GAIN_16X, GAIN_8X, GAIN_4X, GAIN_2X, GAIN_1X
+  };
+
+  // Keep the expected result within 3/4 of full scale
+  int32_t limit = ADCDifferential::full_scale_counts(this->resolution, this->averages) * 3 / 4;
+  int32_t magnitude = normalised < 0 ? -normalised : normalised;
+
+  for (uint8_t k = 0; k < sizeof(gains) / sizeof(gains[0]); k++) {
+    if (magnitude <= limit * adc_gain_to_16x(gains[k]))
+      return gains[k];
+  }
+  return GAIN_DIV2;
+
+}
+
+uint32_t ADCDifferential::calibration_key() {
+  return (uint32_t) this->input_pos 
+    | (uint32_t) this->input_neg 
+    | this->gain 
+    | ((uint32_t) this->reference << 28);
+}
+
+bool ADCDifferential::calibration_short(
+  ADCDifferential::INPUT_PIN_POS* input_pos,
+  ADCDifferential::INPUT_PIN_NEG* input_neg) {
+
+  // MUXNEG only reaches AIN0-7, so short the positive pin to itself if 
+  // possible, otherwise the negative pin
+  uint32_t pos_ain = (uint32_t) this->input_pos >> ADC_INPUTCTRL_MUXPOS_Pos;
+  if (pos_ain <= 7 && cryo_adc_pin_mux_for(pos_ain).group != GROUP_NONE) {
+    *input_pos = this->input_pos;
+    *input_neg = (ADCDifferential::INPUT_PIN_NEG) (pos_ain << ADC_INPUTCTRL_MUXNEG_Pos);
+    return true;
+  }
+  if (this->input_neg != ADCDifferential::INPUT_PIN_NEG::GND) {
+    *input_pos = (ADCDifferential::INPUT_PIN_POS) ((uint32_t) this->input_neg >> ADC_INPUTCTRL_MUXNEG_Pos);
+    *input_neg = this->input_neg;
+    return true;
+  }
+  return false;
+
+}
+
+bool ADCDifferential::calibrate(bool store) {
+
+  if (!this->registered || adc_stream_active || adc_window_armed)
+    return false;
+
+  ADCDifferential::INPUT_PIN_POS short_pos;
+  ADCDifferential::INPUT_PIN_NEG short_neg;
+  if (!this->calibration_short(&short_pos, &short_neg))
+    return false;
+
+  uint32_t key = this->calibration_key();
+  adc_calibration_entry* entry = adc_calibration_find(key);
+  if (entry == NULL && adc_calibration.count >= CRYO_ADC_CALIBRATION_SLOTS)
+    return false;
+
+  ADCDifferential::config cfg = this->get_config();
+  ADCDifferential::config probe = cfg;
+
+  // Reference: the bandgap against GND at GAIN_DIV2 (so it stays in range on
+  // the 1V reference), less the shorted reading at the same gain.  Higher 
+  // gains would clip the bandgap, so their own gain error is not measured.
+  probe.gain = GAIN_DIV2;
+  probe.input_pos = short_pos;
+  probe.input_neg = short_neg;
+  this->configure(probe);
+  int32_t zero = this->read();
+
+  // The bandgap is only routed to the ADC while BGOUTEN is set
+  bool bandgap_output = SYSCTRL->VREF.reg & SYSCTRL_VREF_BGOUTEN;
+  SYSCTRL->VREF.reg |= SYSCTRL_VREF_BGOUTEN;
+  probe.input_pos = ADCDifferential::INPUT_PIN_POS::VREF_BANDGAP_INTERNAL;
+  probe.input_neg = ADCDifferential::INPUT_PIN_NEG::GND;
+  this->configure(probe);
+  int32_t bandgap = this->read() - zero;
+  if (!bandgap_output)
+    SYSCTRL->VREF.reg &= ~SYSCTRL_VREF_BGOUTEN;
+
+  // Offset: shorted inputs at the channel's own gain
+  probe = cfg;
+  probe.input_pos = short_pos;
+  probe.input_neg = short_neg;
+  this->configure(probe);
+  int32_t offset = this->read();
+  this->configure(cfg);
+
+  // Expected result for the nominal bandgap, halved by GAIN_DIV2.  Anything
+  // more than 1/8 away suggests the wrong reference voltage has been defined.
+  int64_t expected = (int64_t) CRYO_ADC_BANDGAP_MICROVOLTS 
+    * ADCDifferential::full_scale_counts(cfg.resolution, cfg.averages) 
+    / (2 * (int64_t) ADCDifferential::reference_microvolts(cfg.reference));
+  if (bandgap <= 0 || bandgap * 8 < expected * 7 || bandgap * 8 > expected * 9)
+    return false;
+
+  if (entry == NULL) {
+    entry = &adc_calibration.entries[adc_calibration.count++];
+    entry->key = key;
+  }
+  entry->reference_q15 = (int32_t) (((expected << 15) + bandgap / 2) / bandgap);
+  entry->offset_microvolts = 0;
+  adc_calibration_generation++;
+
+  // Convert the offset with the corrected reference, then apply it
+  entry->offset_microvolts = this->counts_to_microvolts(offset);
+  adc_calibration_generation++;
+
+  if (store)
+    ADCDifferential::save_calibration();
+
+  return true;
+
+}
+
+void ADCDifferential::save_calibration() {
+
+  if (!adc_calibration_loaded)
+    adc_calibration_load();
+  adc_calibration.magic = ADC_CALIBRATION_MAGIC;
+  adc_calibration_flash_write();
+
+}
+
+void ADCDifferential::clear_calibration(bool store) {
+
+  memset(&adc_calibration, 0, sizeof(adc_calibration));
+  adc_calibration.magic = ADC_CALIBRATION_MAGIC;
+  adc_calibration_loaded = true;
+  adc_calibration_generation++;
+
+  if (store)
+    adc_calibration_flash_write();
+
+}
+
+bool ADCDifferential::is_calibrated() {
+  return adc_calibration_find(this->calibration_key()) != NULL;
+}
+
+void ADCDifferential::update_microvolt_scale() {
+
+  int32_t reference_q15 = 32768;
+  int32_t offset = 0;
+  adc_calibration_entry* entry = adc_calibration_find(this->calibration_key());
+  if (entry != NULL) {
+    reference_q15 = entry->reference_q15;
+    offset = entry->offset_microvolts;
+  }
+
+  // Microvolts per count = reference / (full scale * gain), with the gain 
+  // doubled so GAIN_DIV2 is an integer
+  uint64_t numerator = (uint64_t) ADCDifferential::reference_microvolts(this->reference) * 2 * reference_q15;
+  uint64_t denominator = ((uint64_t) ADCDifferential::full_scale_counts(this->resolution, this->averages) 
+    * ADCDifferential::convert_enum_to_gain_x2(this->gain)) << 15;
+
+  // Largest shift keeping the scale below 2^16, so a 16-bit result times 
+  // the scale fits in 31 bits
+  uint8_t shift = 0;
+  while (shift < 30 && (numerator << (shift + 1)) / denominator < 65536)
+    shift++;
+
+  this->microvolt_scale = (int32_t) (((numerator << shift) + denominator / 2) / denominator);
+  this->microvolt_shift = shift;
+  this->microvolt_offset = offset;
+  this->microvolt_generation = adc_calibration_generation;
+
+}
+
+int32_t ADCDifferential::counts_to_microvolts(int32_t counts) {
+
+  if (this->microvolt_generation != adc_calibration_generation)
+    this->update_microvolt_scale();
+
+  int32_t microvolts = counts * this->microvolt_scale;
+  if (this->microvolt_shift > 0)
+    microvolts = (microvolts + (1l << (this->microvolt_shift - 1))) >> this->microvolt_shift;
+  return microvolts - this->microvolt_offset;
+
+}
+
+int32_t ADCDifferential::read_microvolts() {
+  return this->counts_to_microvolts(this->read());
+}
+
+bool ADCDifferential::start_conversion() {
+
+  if (adc_conversion_pending || adc_stream_active)
+    return false;
+
+  this->activate();
+
+  adc_conversion_ready = false;
+  adc_conversion_callback = this->conversion_complete_callback;
+  adc_conversion_pending = true;
+
+  // Clear any stale result, then let RESRDY raise the ADC interrupt
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+  ADC->INTENSET.reg = ADC_INTENSET_RESRDY;
+  NVIC_EnableIRQ(ADC_IRQn);
+
+  // Trigger conversion
+  ADC->SWTRIG.reg = ADC_SWTRIG_START;
+  this->wait_for_sync();
+
+  return true;
+
+}
+
+bool ADCDifferential::is_ready() {
+  return adc_conversion_ready;
+}
+
+int16_t ADCDifferential::get_result() {
+  return adc_conversion_result;
+}
+
+void ADCDifferential::set_conversion_callback(ADCDifferential::conversion_callback callback) {
+  this->conversion_complete_callback = callback;
+}
+
+uint8_t ADCDifferential::scan(
+  const ADCDifferential::scan_entry* entries,
+  uint8_t count,
+  int16_t* results) {
+
+  if (entries == NULL || results == NULL || count == 0 || adc_stream_active)
+    return 0;
+
+  this->activate();
+
+  // Route every pin in the list to the ADC up-front
+  for (uint8_t k = 0; k < count; k++) {
+    this->input_pin_direction(entries[k].input_pos);
+    this->input_pin_direction(entries[k].input_neg);
+  }
+
+  // The hardware scan steps MUXPOS through INPUTSCAN+1 consecutive inputs
+  // against a fixed MUXNEG, so check whether the list fits that pattern
+  bool hardware_scan = count <= 16;
+  for (uint8_t k = 1; k < count && hardware_scan; k++) {
+    hardware_scan = 
+      entries[k].input_neg == entries[0].input_neg &&
+      (uint32_t) entries[k].input_pos == (uint32_t) entries[0].input_pos + k;
+  }
+
+  // INPUTCTRL is not enable-protected, so the mux can be changed without
+  // the disable/enable cycle used by configure()
+  uint32_t saved_inputctrl = ADC->INPUTCTRL.reg;
+  uint32_t inputctrl = saved_inputctrl & ~(
+    ADC_INPUTCTRL_MUXPOS_Msk | 
+    ADC_INPUTCTRL_MUXNEG_Msk | 
+    ADC_INPUTCTRL_INPUTSCAN_Msk | 
+    ADC_INPUTCTRL_INPUTOFFSET_Msk
+  );
+
+  if (hardware_scan) {
+    ADC->INPUTCTRL.reg = inputctrl 
+      | (uint32_t) entries[0].input_pos 
+      | (uint32_t) entries[0].input_neg
+      | ADC_INPUTCTRL_INPUTSCAN(count - 1);
+    this->wait_for_sync();
+    // INPUTOFFSET advances automatically after each conversion
+    for (uint8_t k = 0; k < count; k++)
+      results[k] = this->read();
+  } else {
+    for (uint8_t k = 0; k < count; k++) {
+      ADC->INPUTCTRL.reg = inputctrl 
+        | (uint32_t) entries[k].input_pos 
+        | (uint32_t) entries[k].input_neg;
+      this->wait_for_sync();
+      results[k] = this->read();
+    }
+  }
+
+  // Restore the configured inputs (which also clears the scan)
+  ADC->INPUTCTRL.reg = saved_inputctrl;
+  this->wait_for_sync();
+
+  return count;
+
+}
+
+// Defined with the clock helpers below
+uint32_t adc_generic_clock_hz();
+
+// Prescaler keeping the ADC clock at or below the rate it had from source_hz
+// once it is fed from standby_hz, so the profile's sampling time still holds
+uint32_t adc_standby_prescaler(uint32_t prescaler, uint32_t source_hz, uint32_t standby_hz) {
+
+  uint32_t code = (prescaler & ADC_CTRLB_PRESCALER_Msk) >> ADC_CTRLB_PRESCALER_Pos;
+  uint32_t target_hz = source_hz / (4ul << code);
+  code = 0;
+  while (code < 7 && standby_hz / (4ul << code) > target_hz)
+    code++;
+  return code << ADC_CTRLB_PRESCALER_Pos;
+
+}
+
+void ADCDifferential::arm_window(
+  int16_t lower,
+  int16_t upper,
+  ADCDifferential::window_callback callback,
+  ADCDifferential::WINDOW_MODE mode,
+  bool free_run) {
+
+  if (adc_window_armed)
+    this->disarm_window();
+
+  this->activate();
+  adc_window_callback = callback;
+  adc_window_owner = this;
+
+  // Thresholds are compared as signed values in differential mode
+  ADC->WINLT.reg = ADC_WINLT_WINLT((uint16_t) lower);
+  this->wait_for_sync();
+  ADC->WINUT.reg = ADC_WINUT_WINUT((uint16_t) upper);
+  this->wait_for_sync();
+  ADC->WINCTRL.reg = mode;
+  this->wait_for_sync();
+
+  ADC->INTFLAG.reg = ADC_INTFLAG_WINMON;
+  ADC->INTENSET.reg = ADC_INTENSET_WINMON;
+  NVIC_EnableIRQ(ADC_IRQn);
+  adc_window_armed = true;
+
+  // A running stream is already free-running
+  adc_window_free_run = free_run && !adc_stream_active;
+  if (adc_window_free_run) {
+    this->disable();
+    // GCLK0 slows or stops under cryo_sleep(), so keep the ADC clocked 
+    // from the standby generator to let the window wake the processor, 
+    // with the prescaler reduced to keep roughly the profile's ADC clock
+    uint32_t source_hz = adc_generic_clock_hz();
+    cryo_standby_clock_attach(GCLK_CLKCTRL_ID_ADC);
+    ADC->CTRLA.reg = ADC->CTRLA.reg | ADC_CTRLA_RUNSTDBY;
+    this->wait_for_sync();
+    adc_window_prescaler = ADC->CTRLB.reg & ADC_CTRLB_PRESCALER_Msk;
+    adc_window_standby = true;
+    ADC->CTRLB.reg = (ADC->CTRLB.reg & ~ADC_CTRLB_PRESCALER_Msk) 
+      | adc_standby_prescaler(adc_window_prescaler, source_hz, adc_generic_clock_hz()) 
+      | ADC_CTRLB_FREERUN;
+    this->wait_for_sync();
+    this->enable();
+    ADC->SWTRIG.reg = ADC_SWTRIG_START;
+    this->wait_for_sync();
+  }
+
+}
+
+void ADCDifferential::disarm_window() {
+
+  if (!adc_window_armed)
+    return;
+
+  ADC->INTENCLR.reg = ADC_INTENCLR_WINMON;
+  ADC->WINCTRL.reg = ADC_WINCTRL_WINMODE_DISABLE;
+  this->wait_for_sync();
+  ADC->INTFLAG.reg = ADC_INTFLAG_WINMON;
+  adc_window_armed = false;
+  adc_window_owner = NULL;
+
+  // Leave free-running mode, unless a stream has since taken it over
+  if (adc_window_free_run && !adc_stream_active) {
+    bool enabled = this->is_enabled();
+    this->disable();
+    ADC->CTRLB.reg = ADC->CTRLB.reg & ~ADC_CTRLB_FREERUN;
+    this->wait_for_sync();
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+    if (enabled) this->enable();
+  }
+  adc_window_free_run = false;
+
+  // Return to the main clock and the profile's prescaler, unless an event
+  // stream now needs the standby clock
+  if (adc_window_standby && !adc_stream_event) {
+    bool enabled = this->is_enabled();
+    this->disable();
+    ADC->CTRLA.reg = ADC->CTRLA.reg & ~ADC_CTRLA_RUNSTDBY;
+    this->wait_for_sync();
+    ADC->CTRLB.reg = (ADC->CTRLB.reg & ~ADC_CTRLB_PRESCALER_Msk) | adc_window_prescaler;
+    this->wait_for_sync();
+    cryo_standby_clock_detach(GCLK_CLKCTRL_ID_ADC);
+    if (enabled) this->enable();
+  }
+  adc_window_standby = false;
+
+}
+
+bool ADCDifferential::is_window_armed() {
+  return adc_window_armed;
+}
+
+bool ADCDifferential::start_stream(
+  int16_t* buffer,
+  uint16_t length,
+  ADCDifferential::stream_callback half_callback,
+  ADCDifferential::stream_callback full_callback) {
+
+  if (adc_stream_active)
+    this->stop_stream();
+
+  this->activate();
+
+  if (!adc_stream_dma_setup(buffer, length, half_callback, full_callback))
+    return false;
+
+  // Switch to free-running mode
+  this->disable();
+  ADC->CTRLB.reg = ADC->CTRLB.reg | ADC_CTRLB_FREERUN;
+  this->wait_for_sync();
+
+  // Clear any stale result so the first beat is a fresh conversion
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+
+  adc_stream_owner = this;
+  adc_stream_active = true;
+  adc_dma.startJob();
+
+  // Free-running conversions still need one start trigger
+  this->enable();
+  ADC->SWTRIG.reg = ADC_SWTRIG_START;
+  this->wait_for_sync();
+
+  return true;
+
+}
+
+bool ADCDifferential::start_event_stream(
+  int16_t* buffer,
+  uint16_t length,
+  ADCDifferential::EVENT_RATE rate,
+  ADCDifferential::stream_callback half_callback,
+  ADCDifferential::stream_callback full_callback) {
+
+  if (adc_stream_active)
+    this->stop_stream();
+
+  this->activate();
+
+  if (!adc_stream_dma_setup(buffer, length, half_callback, full_callback))
+    return false;
+
+  // Keep the DMA channel running in standby (CHCTRLA is selected by CHID, 
+  // which the DMAC interrupt also uses)
+  __disable_irq();
+  DMAC->CHID.reg = adc_dma.getChannel();
+  DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_RUNSTDBY;
+  __enable_irq();
+
+  // Event path: RTC periodic event -> ADC START.  The asynchronous path 
+  // works without the event system clock, so it runs in standby.
+  PM->APBCMASK.reg |= PM_APBCMASK_EVSYS;
+  EVSYS->USER.reg = 
+    EVSYS_USER_USER(EVSYS_ID_USER_ADC_START) |
+    // user channel numbers are offset by one, zero means no channel
+    EVSYS_USER_CHANNEL(CRYO_ADC_EVSYS_CHANNEL + 1);
+  EVSYS->CHANNEL.reg = 
+    EVSYS_CHANNEL_CHANNEL(CRYO_ADC_EVSYS_CHANNEL) |
+    EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_RTC_PER_0 + rate) |
+    EVSYS_CHANNEL_PATH_ASYNCHRONOUS;
+
+  // ADC: clocked in standby, started by events, single conversion mode
+  this->disable();
+  cryo_standby_clock_attach(GCLK_CLKCTRL_ID_ADC);
+  ADC->CTRLB.reg = ADC->CTRLB.reg & ~ADC_CTRLB_FREERUN;
+  this->wait_for_sync();
+  ADC->EVCTRL.reg = ADC_EVCTRL_STARTEI;
+  ADC->CTRLA.reg = ADC->CTRLA.reg | ADC_CTRLA_RUNSTDBY;
+  this->wait_for_sync();
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+
+  adc_stream_owner = this;
+  adc_stream_active = true;
+  adc_stream_event = true;
+  adc_stream_event_rate = rate;
+  adc_dma.startJob();
+  this->enable();
+
+  // Turn on the periodic event output - EVCTRL is enable-protected, so the
+  // RTC is paused briefly (the count is kept)
+  RTC->MODE0.CTRL.reg &= ~RTC_MODE0_CTRL_ENABLE;
+  while (RTC->MODE0.STATUS.bit.SYNCBUSY);
+  RTC->MODE0.EVCTRL.reg |= RTC_MODE0_EVCTRL_PEREO(1 << rate);
+  RTC->MODE0.CTRL.reg |= RTC_MODE0_CTRL_ENABLE;
+  while (RTC->MODE0.STATUS.bit.SYNCBUSY);
+
+  return true;
+
+}
+
+void ADCDifferential::stop_stream() {
+
+  if (!adc_stream_active)
+    return;
+
+  if (adc_stream_event) {
+    // Stop the RTC event first so no further conversions are started
+    RTC->MODE0.CTRL.reg &= ~RTC_MODE0_CTRL_ENABLE;
+    while (RTC->MODE0.STATUS.bit.SYNCBUSY);
+    RTC->MODE0.EVCTRL.reg &= ~RTC_MODE0_EVCTRL_PEREO(1 << adc_stream_event_rate);
+    RTC->MODE0.CTRL.reg |= RTC_MODE0_CTRL_ENABLE;
+    while (RTC->MODE0.STATUS.bit.SYNCBUSY);
+
+    EVSYS->USER.reg = EVSYS_USER_USER(EVSYS_ID_USER_ADC_START) | EVSYS_USER_CHANNEL(0);
+    EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(CRYO_ADC_EVSYS_CHANNEL);
+
+    // Return the ADC to the main clock and software triggering, unless an 
+    // armed window monitor takes it over, free-running in standby
+    bool enabled = this->is_enabled();
+    this->disable();
+    ADC->EVCTRL.reg = 0;
+    if (adc_window_armed) {
+      ADC->CTRLB.reg = ADC->CTRLB.reg | ADC_CTRLB_FREERUN;
+      this->wait_for_sync();
+      adc_window_free_run = true;
+      adc_window_standby = true;
+      // The event stream ran on the standby clock at the configured prescaler
+      adc_window_prescaler = ADC->CTRLB.reg & ADC_CTRLB_PRESCALER_Msk;
+      enabled = true;
+    } else {
+      ADC->CTRLA.reg = ADC->CTRLA.reg & ~ADC_CTRLA_RUNSTDBY;
+      this->wait_for_sync();
+      cryo_standby_clock_detach(GCLK_CLKCTRL_ID_ADC);
+    }
+    if (enabled) this->enable();
+    if (adc_window_armed) {
+      ADC->SWTRIG.reg = ADC_SWTRIG_START;
+      this->wait_for_sync();
+    }
+
+    adc_dma.abort();
+    __disable_irq();
+    DMAC->CHID.reg = adc_dma.getChannel();
+    DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_RUNSTDBY;
+    __enable_irq();
+
+    adc_stream_event = false;
+    adc_stream_active = false;
+    adc_stream_owner = NULL;
+    return;
+  }
+
+  adc_dma.abort();
+  adc_stream_active = false;
+  adc_stream_owner = NULL;
+
+  // An armed window monitor keeps the ADC free-running
+  if (adc_window_armed) {
+    adc_window_free_run = true;
+    return;
+  }
+
+  // Return to single conversion mode, restoring the enabled state
+  bool enabled = this->is_enabled();
+  this->disable();
+  ADC->CTRLB.reg = ADC->CTRLB.reg & ~ADC_CTRLB_FREERUN;
+  this->wait_for_sync();
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+
+  if (enabled) this->enable();
+
+}
+
+bool ADCDifferential::is_streaming() {
+  return adc_stream_active;
+}
+
 ADCDifferential::VOLTAGE_REFERENCE ADCDifferential::get_voltage_reference() {
   return this->reference;
 }
@@ -367,4 +1480,77 @@ float_t ADCDifferential::get_gain_numeric() {
     return 0.5;
   } 
   return 0;
-}
\ No newline at end of file
+}
+
+uint32_t adc_generic_clock_hz() {
+
+  // Select GCLK_ADC and read back the generator it is routed to
+  *((volatile uint8_t*) &GCLK->CLKCTRL.reg) = GCLK_CLKCTRL_ID_ADC;
+  uint32_t generator = (GCLK->CLKCTRL.reg & GCLK_CLKCTRL_GEN_Msk) >> GCLK_CLKCTRL_GEN_Pos;
+
+  // Select the generator and read back its source and division factor
+  *((volatile uint8_t*) &GCLK->GENCTRL.reg) = generator;
+  uint32_t genctrl = GCLK->GENCTRL.reg;
+  *((volatile uint8_t*) &GCLK->GENDIV.reg) = generator;
+  uint32_t div = (GCLK->GENDIV.reg & GCLK_GENDIV_DIV_Msk) >> GCLK_GENDIV_DIV_Pos;
+
+  uint32_t source_hz;
+  switch ((genctrl & GCLK_GENCTRL_SRC_Msk) >> GCLK_GENCTRL_SRC_Pos) {
+    case GCLK_GENCTRL_SRC_OSC8M_Val:
+      source_hz = 8000000ul >> ((SYSCTRL->OSC8M.reg & SYSCTRL_OSC8M_PRESC_Msk) >> SYSCTRL_OSC8M_PRESC_Pos);
+      break;
+    case GCLK_GENCTRL_SRC_OSCULP32K_Val:
+    case GCLK_GENCTRL_SRC_OSC32K_Val:
+    case GCLK_GENCTRL_SRC_XOSC32K_Val:
+      source_hz = 32768;
+      break;
+    case GCLK_GENCTRL_SRC_DFLL48M_Val:
+      source_hz = 48000000ul;
+      break;
+    default:
+      // FDPLL96M, XOSC or GCLKIN - assume the board runs it at F_CPU
+      source_hz = F_CPU;
+      break;
+  }
+
+  // DIVSEL divides by 2^(DIV+1), otherwise DIV (0 and 1 both mean undivided)
+  if (genctrl & GCLK_GENCTRL_DIVSEL)
+    return source_hz >> (div + 1);
+  return div > 1 ? source_hz / div : source_hz;
+
+}
+
+uint32_t ADCDifferential::get_conversion_time_us() {
+
+  // Work in half ADC clock cycles (see 33.6.4 in SAMD21 datasheet)
+  //  sampling:    SAMPLEN + 1 half cycles
+  //  propagation: 1 + resolution/2 + gain delay cycles
+  uint32_t bits = 12;
+  if (this->resolution == RES_10BIT)
+    bits = 10;
+  else if (this->resolution == RES_8BIT)
+    bits = 8;
+
+  uint32_t gain_delay = 0;
+  if (this->gain == GAIN_2X || this->gain == GAIN_4X)
+    gain_delay = 2;
+  else if (this->gain == GAIN_8X || this->gain == GAIN_16X)
+    gain_delay = 3;
+
+  uint32_t half_cycles = (this->sample_length + 1) + 2 * (1 + bits / 2) + gain_delay;
+  uint32_t samples = 1ul << (this->averages >> ADC_AVGCTRL_SAMPLENUM_Pos);
+
+  // GCLK_ADC is normally GCLK0 at F_CPU, but start_event_stream() moves it
+  // to the standby generator, so use whichever generator is routed to it
+  // arm_window() also lowers the prescaler while on the standby generator
+  uint32_t prescaler = this->prescaler;
+  if (adc_window_standby && adc_window_owner == this)
+    prescaler = ADC->CTRLB.reg;
+  uint32_t divider = 4ul << ((prescaler & ADC_CTRLB_PRESCALER_Msk) >> ADC_CTRLB_PRESCALER_Pos);
+  uint32_t adc_clock_hz = adc_generic_clock_hz() / divider;
+  if (adc_clock_hz == 0)
+    return 0;
+
+  return (uint32_t) (((uint64_t) half_cycles * samples * 1000000) / (2 * (uint64_t) adc_clock_hz));
+
+}
@@ -110,6 +110,84 @@ EXAMPLE USAGE:
 // Simple macros to make sure we're using the right numbers for GPIO group IDs
 #define GROUP_0 0
 #define GROUP_1 1
+/*
+    ADC Event Channel
+    -----------------
+    Event system channel used by start_event_stream() to route the RTC
+    periodic event to the ADC.  Can be defined prior to including 
+    cryo_adc.h if channel 0 is already in use.
+*/
+#ifndef CRYO_ADC_EVSYS_CHANNEL
+#define CRYO_ADC_EVSYS_CHANNEL 0
+#endif
+
+/*
+    ADC Calibration
+    ---------------
+    Nominal voltages used to convert counts to microvolts.  The bandgap is 
+    measured by calibrate() to correct the reference voltage; the supply 
+    sets the INTVCC references and the AREF voltage should be defined 
+    to match any external reference on A3.  CRYO_ADC_CALIBRATION_SLOTS 
+    sets how many channels can be calibrated (the table must fit in one 
+    256 byte flash row).
+*/
+#ifndef CRYO_ADC_BANDGAP_MICROVOLTS
+#define CRYO_ADC_BANDGAP_MICROVOLTS 1100000
+#endif
+#ifndef CRYO_ADC_VDD_MICROVOLTS
+#define CRYO_ADC_VDD_MICROVOLTS 3300000
+#endif
+#ifndef CRYO_ADC_AREF_MICROVOLTS
+#define CRYO_ADC_AREF_MICROVOLTS 1000000
+#endif
+#ifndef CRYO_ADC_CALIBRATION_SLOTS
+#define CRYO_ADC_CALIBRATION_SLOTS 16
+#endif
+
+// Group used in the pin mux table for inputs that aren't routed to a pin
+#define GROUP_NONE 0xff
+
+/*
+    ADC Pin Mux Table
+    -----------------
+    PORT group and pin number for each analogue input AIN[n] on the
+    Adafruit Feather M0, indexed by n (the MUXPOS/MUXNEG pin number).  
+    Inputs that aren't broken out, and the internal inputs, have no entry.
+*/
+typedef struct cryo_adc_pin_mux {
+    uint8_t group;
+    uint8_t pin;
+} cryo_adc_pin_mux;
+
+constexpr cryo_adc_pin_mux CRYO_ADC_PIN_MUX[] = {
+    {GROUP_0, 2},           // AIN0  - PA02 (A0)
+    {GROUP_NONE, 0},        // AIN1
+    {GROUP_1, 8},           // AIN2  - PB08 (A1)
+    {GROUP_1, 9},           // AIN3  - PB09 (A2)
+    {GROUP_0, 4},           // AIN4  - PA04 (A3)
+    {GROUP_0, 5},           // AIN5  - PA05 (A4)
+    {GROUP_NONE, 0},        // AIN6
+    {GROUP_0, 7},           // AIN7  - PA07 (D9)
+    {GROUP_NONE, 0},        // AIN8
+    {GROUP_NONE, 0},        // AIN9
+    {GROUP_1, 2},           // AIN10 - PB02 (A5)
+    {GROUP_NONE, 0},        // AIN11
+    {GROUP_NONE, 0},        // AIN12
+    {GROUP_NONE, 0},        // AIN13
+    {GROUP_NONE, 0},        // AIN14
+    {GROUP_NONE, 0},        // AIN15
+    {GROUP_NONE, 0},        // AIN16
+    {GROUP_NONE, 0},        // AIN17
+    {GROUP_0, 10},          // AIN18 - PA10 (D1)
+    {GROUP_0, 11},          // AIN19 - PA11 (D0)
+};
+
+// Returns the table entry for AIN[ain], or a GROUP_NONE entry for internal inputs
+constexpr cryo_adc_pin_mux cryo_adc_pin_mux_for(uint32_t ain) {
+    return ain < sizeof(CRYO_ADC_PIN_MUX) / sizeof(CRYO_ADC_PIN_MUX[0]) 
+        ? CRYO_ADC_PIN_MUX[ain] 
+        : cryo_adc_pin_mux{GROUP_NONE, 0};
+}
 
 /*
 
@@ -130,8 +208,8 @@ class ADCDifferential {
         A3_PIN = ADC_INPUTCTRL_MUXPOS_PIN4,
         A4_PIN = ADC_INPUTCTRL_MUXPOS_PIN5,
         A5_PIN = ADC_INPUTCTRL_MUXPOS_PIN10,
-        D0_PIN = ADC_INPUTCTRL_MUXPOS_PIN9,
-        D1_PIN = ADC_INPUTCTRL_MUXPOS_PIN8,
+        D0_PIN = ADC_INPUTCTRL_MUXPOS_PIN19,
+        D1_PIN = ADC_INPUTCTRL_MUXPOS_PIN18,
         D9_PIN = ADC_INPUTCTRL_MUXPOS_PIN7,
         DAC_PIN = ADC_INPUTCTRL_MUXPOS_DAC,
         VREF_BANDGAP_INTERNAL = ADC_INPUTCTRL_MUXPOS_BANDGAP,
@@ -194,6 +272,84 @@ class ADCDifferential {
         AVG_X1024 = ADC_AVGCTRL_SAMPLENUM_1024,
     };
 
+    // ADC clock prescaler (from GCLK_ADC), as specified in 33.8.5
+    enum PRESCALER {
+        PRESCALER_DIV4 = ADC_CTRLB_PRESCALER_DIV4,
+        PRESCALER_DIV8 = ADC_CTRLB_PRESCALER_DIV8,
+        PRESCALER_DIV16 = ADC_CTRLB_PRESCALER_DIV16,
+        PRESCALER_DIV32 = ADC_CTRLB_PRESCALER_DIV32,
+        PRESCALER_DIV64 = ADC_CTRLB_PRESCALER_DIV64,
+        PRESCALER_DIV128 = ADC_CTRLB_PRESCALER_DIV128,
+        PRESCALER_DIV256 = ADC_CTRLB_PRESCALER_DIV256,
+        PRESCALER_DIV512 = ADC_CTRLB_PRESCALER_DIV512,
+    };
+
+    // Named combinations of prescaler, sample length and averaging
+    //  TIMING_FAST      - 1.5 MHz ADC clock, shortest sampling, 16 averages
+    //                     (low impedance sources, e.g. bridge inputs)
+    //  TIMING_BALANCED  - 750 kHz ADC clock, 2 cycle sampling, 64 averages
+    //  TIMING_PRECISE   - 187.5 kHz ADC clock, 8 cycle sampling, 1024 averages
+    //                     (high impedance sources, e.g. the PT1000 divider)
+    // ADC clock rates assume GCLK_ADC is running at 48 MHz
+    enum TIMING_PROFILE {
+        TIMING_FAST,
+        TIMING_BALANCED,
+        TIMING_PRECISE
+    };
+
+    // Sample rates available to start_event_stream(), taken from the RTC periodic
+    // events (18.6.8.1) with the 1.024 kHz RTC clock set by cryo_configure_clock()
+    enum EVENT_RATE {
+        EVENT_128HZ = 0,
+        EVENT_64HZ = 1,
+        EVENT_32HZ = 2,
+        EVENT_16HZ = 3,
+        EVENT_8HZ = 4,
+        EVENT_4HZ = 5,
+        EVENT_2HZ = 6,
+        EVENT_1HZ = 7
+    };
+
+    // Window monitor modes, as specified in 33.8.10
+    enum WINDOW_MODE {
+        WINDOW_DISABLED = ADC_WINCTRL_WINMODE_DISABLE,
+        WINDOW_ABOVE = ADC_WINCTRL_WINMODE_MODE1,     // result > lower
+        WINDOW_BELOW = ADC_WINCTRL_WINMODE_MODE2,     // result < upper
+        WINDOW_INSIDE = ADC_WINCTRL_WINMODE_MODE3,    // lower < result < upper
+        WINDOW_OUTSIDE = ADC_WINCTRL_WINMODE_MODE4    // result outside lower..upper
+    };
+
+    // Complete channel configuration, applied in one transaction by configure()
+    struct config {
+        ADCDifferential::INPUT_PIN_POS input_pos;
+        ADCDifferential::INPUT_PIN_NEG input_neg;
+        ADCDifferential::GAIN gain;
+        ADCDifferential::AVERAGES averages;
+        ADCDifferential::RESOLUTION resolution;
+        ADCDifferential::VOLTAGE_REFERENCE reference;
+        ADCDifferential::PRESCALER prescaler;
+        // sampling time in half ADC clock cycles, minus one (0-63)
+        uint8_t sample_length;
+    };
+
+    // Positive/negative pin pair converted by scan()
+    struct scan_entry {
+        ADCDifferential::INPUT_PIN_POS input_pos;
+        ADCDifferential::INPUT_PIN_NEG input_neg;
+    };
+
+    // Callback used by start_conversion() - called from the ADC interrupt
+    // with the result of the completed conversion
+    typedef void (*conversion_callback)(int16_t result);
+
+    // Callback used by the window monitor - called from the ADC interrupt 
+    // with the result that met the window condition
+    typedef void (*window_callback)(int16_t result);
+
+    // Callback used by the streaming mode - called from the DMAC interrupt with
+    // a pointer to the half of the ring buffer that has just been filled
+    typedef void (*stream_callback)(int16_t* samples, uint16_t count);
+
     private:
         // Input and output pins
         ADCDifferential::INPUT_PIN_POS input_pos;
@@ -211,11 +367,39 @@ class ADCDifferential {
         // Averages
         ADCDifferential::AVERAGES averages;
 
+        // Timing
+        ADCDifferential::PRESCALER prescaler;
+        uint8_t sample_length;
+
+        // Called when a conversion started by start_conversion() completes
+        ADCDifferential::conversion_callback conversion_complete_callback;
+
+        // Fixed point conversion to microvolts: uV = ((counts * scale) >> shift) - offset,
+        // recalculated when the configuration or calibration changes
+        int32_t microvolt_scale;
+        uint8_t microvolt_shift;
+        int32_t microvolt_offset;
+        uint32_t microvolt_generation;
+
+        // Last result from read_autorange(), normalised to GAIN_16X counts
+        int32_t autorange_last;
+        bool autorange_valid;
+
     public:
         // Convert a gain value to the nearest accepted value and return the corresponding enum
         static ADCDifferential::GAIN convert_gain_to_enum(float_t gain);
         // Convert a gain enum to the corresponding numeric gain
         static float_t convert_enum_to_gain(ADCDifferential::GAIN);
+        // Convert a gain enum to twice the numeric gain, as an integer (GAIN_DIV2 = 1)
+        static uint8_t convert_enum_to_gain_x2(ADCDifferential::GAIN gain);
+        // Returns the nominal voltage of a reference in microvolts
+        static uint32_t reference_microvolts(ADCDifferential::VOLTAGE_REFERENCE reference);
+        // Returns the magnitude of a full scale result for the given resolution
+        // and averaging (results are signed, so range from -full scale to +full scale - 1)
+        static int32_t full_scale_counts(
+            ADCDifferential::RESOLUTION resolution,
+            ADCDifferential::AVERAGES averages
+        );
 
         // Class constructor
         ADCDifferential(
@@ -228,11 +412,16 @@ class ADCDifferential {
         );
 
         // Class destructor
-        //  called when the class is out of scope - used to disable the ADC
+        //  called when the class is out of scope - calls end()
         ~ADCDifferential();
 
-        // Initialise the ADC with the parameters specified (calls clock and ADC init functions)
+        // Initialise the ADC with the parameters specified.  Registers the 
+        // instance with the ADCManager, which initialises the clock and ADC
+        // when the first instance begins.
         void begin();
+        // Release the ADC, stopping any stream or window monitor started by 
+        // this instance.  The ADC is powered down when the last instance ends.
+        void end();
 
         // enable the ADC
         void enable();
@@ -245,9 +434,144 @@ class ADCDifferential {
         // Read ADC value as a right-adjusted, 16-bit signed integer
         int16_t read();
 
+        // Convert each pin pair in entries in order, writing one result per pair
+        // to results.  Uses the hardware input scan when all pairs share a 
+        // negative pin and the positive inputs are consecutive, otherwise the mux 
+        // is switched between conversions without disabling the ADC.  This 
+        // instance's input pins are restored afterwards.  Returns the number of 
+        // results written.
+        uint8_t scan(
+            const ADCDifferential::scan_entry* entries,
+            uint8_t count,
+            int16_t* results
+        );
+
+        // Read with automatic gain selection.  The highest gain from GAIN_DIV2 to
+        // GAIN_16X that keeps the result within 3/4 of full scale is chosen using
+        // the previous auto-ranged result, or a quick probe conversion (GAIN_DIV2,
+        // 4 averages) if there isn't one or the result came out close to clipping.
+        // The chosen gain is left configured and written to gain_used if it isn't
+        // NULL.  Returns the result normalised to GAIN_16X counts, i.e. the raw
+        // result multiplied by 16 / gain.
+        int32_t read_autorange(ADCDifferential::GAIN* gain_used = NULL);
+
+        /********************************************************************/
+        /* CALIBRATION                                                      */
+        /********************************************************************/
+
+        // Measure the offset (with both inputs shorted to the same pin) at the
+        // current gain and the reference error (against the internal bandgap
+        // at GAIN_DIV2) for the current pins, gain and reference, and store the
+        // coefficients for this channel, writing the table to flash if store is
+        // true.  The error of the gain stage itself is not corrected - the
+        // bandgap would clip above GAIN_DIV2, so the same reference correction
+        // is measured whatever the channel's gain.  Returns
+        // false if the inputs can't be shorted (the positive pin must be AIN0-7, 
+        // or the negative pin not GND), or the bandgap reading is implausible.
+        bool calibrate(bool store = true);
+        // Write the calibration table to flash, which survives resets but
+        // is erased when new firmware is uploaded
+        static void save_calibration();
+        // Discard all calibration coefficients (and the copy in flash if store is true)
+        static void clear_calibration(bool store = true);
+        // Returns true if the current channel has been calibrated
+        bool is_calibrated();
+
+        // Convert a result to microvolts at the input, using the channel's 
+        // calibration (if any) in fixed point
+        int32_t counts_to_microvolts(int32_t counts);
+        // Read the ADC and convert the result to microvolts
+        int32_t read_microvolts();
+
+        /********************************************************************/
+        /* NON-BLOCKING CONVERSIONS                                         */
+        /********************************************************************/
+        // Trigger a conversion and return immediately - the result is collected
+        // by the ADC interrupt, so the processor can sleep or do other work.
+        // Returns false if a conversion or stream is already running.
+        bool start_conversion();
+        // check whether the conversion started by start_conversion() has completed
+        bool is_ready();
+        // returns the result of the last conversion completed by start_conversion()
+        int16_t get_result();
+        // set a function to be called from the ADC interrupt when a conversion 
+        // started by start_conversion() completes (NULL to disable)
+        void set_conversion_callback(ADCDifferential::conversion_callback callback);
+
+        /********************************************************************/
+        /* WINDOW MONITOR                                                   */
+        /********************************************************************/
+        // Arm the window monitor so that the ADC interrupt is only raised for
+        // results that meet the window condition - by default, results outside
+        // lower..upper.  The limits are signed, as the ADC is in differential
+        // mode.  If free_run is true the ADC is set free-running on the standby
+        // clock (CRYO_STANDBY_GCLK) with RUNSTDBY set, so every conversion is
+        // checked and the interrupt wakes the processor from cryo_sleep().
+        // The standby generator runs from OSC8M (8 MHz), so the prescaler is
+        // lowered to keep the ADC clock at or just below the timing profile's
+        // rate (e.g. TIMING_FAST runs at 1 MHz rather than 1.5 MHz), as 
+        // reported by get_conversion_time_us(), and restored by 
+        // disarm_window().  OSC8M stays on through standby while the window 
+        // is armed, costing roughly 65 uA on top of the ADC itself.
+        // read() must not be used while a free-running window is armed.
+        // Otherwise conversions come from start_conversion() or the streaming
+        // modes, and the window only wakes the processor if they run in standby
+        // (start_event_stream()).  callback is called for every result meeting
+        // the condition until disarm_window() is called.
+        void arm_window(
+            int16_t lower,
+            int16_t upper,
+            ADCDifferential::window_callback callback,
+            ADCDifferential::WINDOW_MODE mode = ADCDifferential::WINDOW_MODE::WINDOW_OUTSIDE,
+            bool free_run = true
+        );
+        // disable the window monitor (and free-running mode if arm_window() set it)
+        void disarm_window();
+        // check whether the window monitor is armed
+        bool is_window_armed();
+
+        /********************************************************************/
+        /* STREAMING                                                        */
+        /********************************************************************/
+        // Start free-running conversions with the DMAC copying each result into
+        // buffer, which is used as a ring of length samples (length must be even).
+        // half_callback is called when the first half fills, full_callback when 
+        // the second half fills - either can be NULL.  read() must not be used 
+        // while streaming.  Returns false if the stream could not be started.
+        bool start_stream(
+            int16_t* buffer,
+            uint16_t length,
+            ADCDifferential::stream_callback half_callback,
+            ADCDifferential::stream_callback full_callback
+        );
+        // Start sampling at a fixed rate without waking the processor: the RTC
+        // periodic event is routed through the event system to the ADC start 
+        // input and the DMAC copies each result into buffer, as for start_stream().
+        // The ADC, DMAC and event path keep running during cryo_sleep(), so the
+        // processor only wakes for the callbacks when each half of the buffer
+        // has filled.  Requires cryo_configure_clock() to have been called.
+        // Returns false if the stream could not be started.
+        bool start_event_stream(
+            int16_t* buffer,
+            uint16_t length,
+            ADCDifferential::EVENT_RATE rate,
+            ADCDifferential::stream_callback half_callback,
+            ADCDifferential::stream_callback full_callback
+        );
+        // stop streaming and return the ADC to single conversion mode
+        void stop_stream();
+        // check whether a stream is running
+        bool is_streaming();
+
         /********************************************************************/
         /* SETTERS                                                          */
         /********************************************************************/
+        // Apply a complete configuration with a single disable/write/sync/enable
+        // cycle.  Only registers that differ from the last configuration written
+        // are touched, and nothing is done if the configuration is unchanged.
+        // The individual setters below are shorthands for this.
+        void configure(const ADCDifferential::config& cfg);
+
         void set_input_pins(
             ADCDifferential::INPUT_PIN_POS input_pos,
             ADCDifferential::INPUT_PIN_NEG input_neg
@@ -271,9 +595,26 @@ class ADCDifferential {
 
         void set_averages(ADCDifferential::AVERAGES averages);
 
+        void set_prescaler(ADCDifferential::PRESCALER prescaler);
+        // sampling time in half ADC clock cycles, minus one (0-63)
+        void set_sample_length(uint8_t sample_length);
+        // sets the prescaler, sample length and averages together
+        void set_timing_profile(ADCDifferential::TIMING_PROFILE profile);
+
         /********************************************************************/
         /* GETTERS                                                          */
         /********************************************************************/
+        // returns the configuration held by this instance
+        ADCDifferential::config get_config();
+
+        // Switch the ADC inputs and gain using precomputed pin routing and 
+        // INPUTCTRL value, without disabling the ADC - used by AdcChannel
+        static void select_inputs(
+            cryo_adc_pin_mux pos,
+            cryo_adc_pin_mux neg,
+            uint32_t inputctrl
+        );
+
         ADCDifferential::INPUT_PIN_POS get_input_pin_positive();
         ADCDifferential::INPUT_PIN_POS get_input_pin_negative();
 
@@ -285,21 +626,197 @@ class ADCDifferential {
         // returns the gain of the ADC in numeric form
         float_t get_gain_numeric();
 
+        // returns the estimated time for one (averaged) result in microseconds,
+        // based on the generic clock routed to the ADC, prescaler, sample length,
+        // resolution, gain and averaging
+        uint32_t get_conversion_time_us();
+
     private:
-        void generic_clock_init();
-        void adc_init();
+        // ADCManager applies the configuration and pin routing on our behalf
+        friend class ADCManager;
+
+        // Set while the instance is registered with the ADCManager (begin() to end())
+        bool registered;
+
+        // Apply this instance's configuration before using the ADC
+        void activate();
+
         void wait_for_sync();
 
         void input_pin_direction(ADCDifferential::INPUT_PIN_POS input_pos);
         void input_pin_direction(ADCDifferential::INPUT_PIN_NEG input_neg);
 
-        void input_pin_direction_register_set(
-            uint8_t group,
-            uint32_t dirclr,
-            uint16_t pincfg,
-            uint16_t pmux,
-            uint8_t pmuxreg
+        static void input_pin_direction_register_set(cryo_adc_pin_mux mux);
+
+        bool calibration_short(
+            ADCDifferential::INPUT_PIN_POS* input_pos,
+            ADCDifferential::INPUT_PIN_NEG* input_neg
         );
+        uint32_t calibration_key();
+        void update_microvolt_scale();
+
+        int32_t autorange_probe();
+        ADCDifferential::GAIN autorange_select_gain(int32_t normalised);
+
+};
+
+/*
+
+    class ADCManager
+    description:
+        arbitrates the single ADC between ADCDifferential instances.  The 
+        clock, calibration and differential mode are set up once when the 
+        first instance registers, the configuration last written to the 
+        registers is cached so switching between instances only rewrites 
+        registers that differ, and the ADC is disabled and its clocks gated
+        when the last instance releases it.
+    
+    example:
+        ADCDifferential a(
+            ADCDifferential::INPUT_PIN_POS::A1_PIN, ADCDifferential::INPUT_PIN_NEG::GND
+        );
+        ADCDifferential b(
+            ADCDifferential::INPUT_PIN_POS::A2_PIN, ADCDifferential::INPUT_PIN_NEG::GND
+        );
+        a.begin();  // initialises the ADC
+        b.begin();  // shares it
+        a.read();   // writes a's configuration
+        b.read();   // rewrites INPUTCTRL only
+        a.end();
+        b.end();    // powers the ADC down
+
+*/
+class ADCManager {
+
+    public:
+
+        ADCManager();
+
+        // Register an instance, initialising the ADC if it is the first
+        void acquire();
+        // Unregister an instance, powering the ADC down if it was the last
+        void release();
+        // Returns the number of registered instances
+        uint8_t get_users();
+
+        // Write the registers that differ between cfg and the active configuration
+        void apply(const ADCDifferential::config& cfg);
+        // Route the inputs and write INPUTCTRL (mux and gain) unless already selected.
+        // The channel is kept by later apply() calls until clear_selection().
+        void apply_inputs(cryo_adc_pin_mux pos, cryo_adc_pin_mux neg, uint32_t inputctrl);
+        // Let apply() write each instance's own inputs and gain again
+        void clear_selection();
+        // Forget the active configuration so the next apply() writes every register
+        void invalidate();
+
+    private:
+        uint8_t users;
+        // Configuration last written to the ADC registers
+        ADCDifferential::config active;
+        bool active_valid;
+        // Set by apply_inputs() - apply() keeps the selected inputs and gain
+        bool inputs_selected;
+
+        void generic_clock_init();
+        void adc_init();
+        void power_down();
+
+};
+
+/*
+    name:           cryo_get_adc_manager()
+    description:    returns the ADCManager shared by all ADCDifferential instances
+    arguments:      none
+    returns:        pointer to ADCManager object
+*/
+ADCManager* cryo_get_adc_manager();
+
+// Returns true if gain is one of the ADCDifferential::GAIN values
+constexpr bool cryo_adc_is_valid_gain(uint32_t gain) {
+    return gain == ADCDifferential::GAIN::GAIN_DIV2
+        || gain == ADCDifferential::GAIN::GAIN_1X
+        || gain == ADCDifferential::GAIN::GAIN_2X
+        || gain == ADCDifferential::GAIN::GAIN_4X
+        || gain == ADCDifferential::GAIN::GAIN_8X
+        || gain == ADCDifferential::GAIN::GAIN_16X;
+}
+
+// Returns true if the input is internal, or is routed to a pin on the board
+constexpr bool cryo_adc_is_valid_input(uint32_t ain) {
+    return ain >= sizeof(CRYO_ADC_PIN_MUX) / sizeof(CRYO_ADC_PIN_MUX[0]) 
+        || cryo_adc_pin_mux_for(ain).group != GROUP_NONE;
+}
+
+// Returns true if both inputs are the same external AIN pin.  MUXPOS and MUXNEG
+// share codes below 0x14 only; above that the codes select unrelated internal
+// inputs (e.g. MUXPOS TEMP and MUXNEG GND are both 0x18).
+constexpr bool cryo_adc_is_same_pin(uint32_t muxpos, uint32_t muxneg) {
+    return muxpos < 0x14 && muxneg < 0x14 && muxpos == muxneg;
+}
+
+/*
+
+    class AdcChannel
+    description:
+        compile-time specialised ADC channel.  The pin routing and INPUTCTRL
+        value are computed by the compiler, so select() is reduced to a few
+        register stores, and invalid pin/gain combinations fail to compile.
+        The selected inputs and gain are used by read() on any instance until
+        another channel is selected or an instance is reconfigured (set_*(),
+        configure()), which returns each instance to its own inputs.  Only the
+        raw result applies to the selected channel - conversions to microvolts
+        use the instance's own gain and calibration.
+
+    example:
+        AdcChannel<
+            ADCDifferential::INPUT_PIN_POS::A1_PIN,
+            ADCDifferential::INPUT_PIN_NEG::GND,
+            ADCDifferential::GAIN_4X
+        > pt1000_channel;
+
+        pt1000_channel.select();
+        int16_t result = my_adc.read();
+
+*/
+template <
+    ADCDifferential::INPUT_PIN_POS POS,
+    ADCDifferential::INPUT_PIN_NEG NEG,
+    ADCDifferential::GAIN G = ADCDifferential::GAIN::GAIN_1X
+>
+class AdcChannel {
+
+    static_assert(
+        cryo_adc_is_valid_input((uint32_t) POS >> ADC_INPUTCTRL_MUXPOS_Pos),
+        "positive input is not routed to a pin on this board"
+    );
+    static_assert(
+        cryo_adc_is_valid_input((uint32_t) NEG >> ADC_INPUTCTRL_MUXNEG_Pos),
+        "negative input is not routed to a pin on this board"
+    );
+    static_assert(
+        !cryo_adc_is_same_pin(
+            (uint32_t) POS >> ADC_INPUTCTRL_MUXPOS_Pos,
+            (uint32_t) NEG >> ADC_INPUTCTRL_MUXNEG_Pos
+        ),
+        "positive and negative inputs must be different pins"
+    );
+    static_assert(
+        cryo_adc_is_valid_gain((uint32_t) G),
+        "gain must be one of ADCDifferential::GAIN"
+    );
+
+    public:
+        // INPUTCTRL register value for this channel
+        static constexpr uint32_t INPUTCTRL = (uint32_t) POS | (uint32_t) NEG | (uint32_t) G;
+
+        // Route the pins and switch the ADC to this channel
+        static void select() {
+            ADCDifferential::select_inputs(
+                cryo_adc_pin_mux_for((uint32_t) POS >> ADC_INPUTCTRL_MUXPOS_Pos),
+                cryo_adc_pin_mux_for((uint32_t) NEG >> ADC_INPUTCTRL_MUXNEG_Pos),
+                INPUTCTRL
+            );
+        }
 
 };
 
@@ -0,0 +1,166 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+*****************************************************************************/
+
+#include "cryo_codec.h"
+
+uint8_t cryo_codec_put_varint(uint32_t value, uint8_t* buffer, uint16_t space) {
+
+  uint8_t length = 0;
+  do {
+    if (length >= space)
+      return 0;
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    buffer[length++] = value ? byte | 0x80 : byte;
+  } while (value);
+  return length;
+
+}
+
+uint8_t cryo_codec_get_varint(const uint8_t* buffer, uint16_t length, uint32_t* value) {
+
+  uint32_t result = 0;
+  for (uint8_t k = 0; k < length && k < CRYO_CODEC_VARINT_MAX_LENGTH; k++) {
+    result |= (uint32_t) (buffer[k] & 0x7f) << (7 * k);
+    if (!(buffer[k] & 0x80)) {
+      *value = result;
+      return k + 1;
+    }
+  }
+  return 0;
+
+}
+
+bool cryo_codec_delta_init(cryo_codec_delta* codec, uint8_t fields) {
+
+  if (fields == 0 || fields > CRYO_CODEC_MAX_FIELDS)
+    return false;
+
+  codec->fields = fields;
+  for (uint8_t k = 0; k < CRYO_CODEC_MAX_FIELDS; k++)
+    codec->previous[k] = 0;
+  return true;
+
+}
+
+uint16_t cryo_codec_delta_encode(cryo_codec_delta* codec, const int32_t* values, uint8_t* buffer, uint16_t space) {
+
+  // Encode into a scratch buffer first so a reading that doesn't fit leaves 
+  // both the buffer and the encoder untouched
+  uint8_t scratch[CRYO_CODEC_MAX_FIELDS * CRYO_CODEC_VARINT_MAX_LENGTH];
+  uint16_t length = 0;
+  for (uint8_t k = 0; k < codec->fields; k++) {
+    // Differences wrap, which the decoder undoes
+    uint32_t delta = (uint32_t) values[k] - (uint32_t) codec->previous[k];
+    length += cryo_codec_put_varint(
+      cryo_codec_zigzag((int32_t) delta), 
+      scratch + length, 
+      sizeof(scratch) - length
+    );
+  }
+
+  if (length > space)
+    return 0;
+
+  memcpy(buffer, scratch, length);
+  for (uint8_t k = 0; k < codec->fields; k++)
+    codec->previous[k] = values[k];
+  return length;
+
+}
+
+uint16_t cryo_codec_delta_decode(cryo_codec_delta* codec, const uint8_t* buffer, uint16_t length, int32_t* values) {
+
+  uint16_t position = 0;
+  for (uint8_t k = 0; k < codec->fields; k++) {
+    uint32_t zigzag;
+    uint8_t read = cryo_codec_get_varint(buffer + position, length - position, &zigzag);
+    if (read == 0)
+      return 0;
+    position += read;
+    values[k] = (int32_t) ((uint32_t) codec->previous[k] + (uint32_t) cryo_codec_unzigzag(zigzag));
+  }
+
+  for (uint8_t k = 0; k < codec->fields; k++)
+    codec->previous[k] = values[k];
+  return position;
+
+}
+
+void cryo_codec_xor_init(cryo_codec_xor* codec) {
+  codec->previous = 0;
+}
+
+uint8_t cryo_codec_xor_encode(cryo_codec_xor* codec, float_t value, uint8_t* buffer, uint16_t space) {
+
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t difference = bits ^ codec->previous;
+
+  // Count whole bytes of matching (zero) bits from each end
+  uint8_t leading = 0;
+  while (leading < 4 && !(difference & (0xff000000ul >> (8 * leading))))
+    leading++;
+  uint8_t trailing = 0;
+  while (leading + trailing < 4 && !(difference & (0xfful << (8 * trailing))))
+    trailing++;
+  uint8_t middle = 4 - leading - trailing;
+
+  if (1 + middle > space)
+    return 0;
+
+  buffer[0] = (leading << 4) | trailing;
+  for (uint8_t k = 0; k < middle; k++)
+    buffer[1 + k] = (difference >> (8 * (3 - leading - k))) & 0xff;
+
+  codec->previous = bits;
+  return 1 + middle;
+
+}
+
+uint8_t cryo_codec_xor_decode(cryo_codec_xor* codec, const uint8_t* buffer, uint16_t length, float_t* value) {
+
+  if (length < 1)
+    return 0;
+  uint8_t leading = buffer[0] >> 4;
+  uint8_t trailing = buffer[0] & 0x0f;
+  if (leading + trailing > 4)
+    return 0;
+  uint8_t middle = 4 - leading - trailing;
+  if (1 + middle > length)
+    return 0;
+
+  uint32_t difference = 0;
+  for (uint8_t k = 0; k < middle; k++)
+    difference |= (uint32_t) buffer[1 + k] << (8 * (3 - leading - k));
+
+  uint32_t bits = codec->previous ^ difference;
+  codec->previous = bits;
+  memcpy(value, &bits, sizeof(bits));
+  return 1 + middle;
+
+}
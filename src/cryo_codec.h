@@ -0,0 +1,211 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+FILE: 
+    cryo_codec.h
+
+DESCRIPTION: 
+    Compression for series of readings, e.g. for batched radio frames or 
+    uploading a backlog.  Consecutive readings change very little, so each
+    field is sent as the difference from its previous value, zig-zag encoded
+    (so small negative differences are small numbers) and packed as a 
+    varint (7 bits per byte, high bit set on all but the last byte).  A 
+    field that changes by less than +/-64 takes one byte.
+
+    For series of raw floats, the XOR encoder sends only the bytes that 
+    differ from the previous value.
+
+    Encoders and decoders hold the previous values, so a series must be 
+    decoded in order from the start, using a decoder initialised the same
+    way as the encoder.
+
+EXAMPLE USAGE:
+
+    cryo_codec_delta encoder;
+    cryo_codec_delta_init(&encoder, 2);
+
+    uint8_t buffer[64];
+    uint16_t length = 0;
+    int32_t reading[2] = {2150, -15230};
+    length += cryo_codec_delta_encode(&encoder, reading, buffer + length, sizeof(buffer) - length);
+
+*/
+#include <Arduino.h>
+
+#ifndef CRYO_CODEC_H
+#define CRYO_CODEC_H
+
+// Most fields per reading in a delta-encoded series
+#ifndef CRYO_CODEC_MAX_FIELDS
+#define CRYO_CODEC_MAX_FIELDS 12
+#endif
+
+// Longest varint (a 32-bit value)
+#define CRYO_CODEC_VARINT_MAX_LENGTH 5
+
+typedef struct cryo_codec_delta {
+    int32_t previous[CRYO_CODEC_MAX_FIELDS];
+    uint8_t fields;
+} cryo_codec_delta;
+
+typedef struct cryo_codec_xor {
+    uint32_t previous;
+} cryo_codec_xor;
+
+/*
+    name:           cryo_codec_zigzag(int32_t value)
+    description:    maps signed values to unsigned so small magnitudes stay small
+                    (0, -1, 1, -2, 2 ... to 0, 1, 2, 3, 4 ...)
+    arguments:      value
+                        - signed value
+    returns:        zig-zag encoded value
+*/
+inline uint32_t cryo_codec_zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+/*
+    name:           cryo_codec_unzigzag(uint32_t value)
+    description:    reverses cryo_codec_zigzag()
+    arguments:      value
+                        - zig-zag encoded value
+    returns:        signed value
+*/
+inline int32_t cryo_codec_unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+/*
+    name:           cryo_codec_put_varint(uint32_t value, uint8_t* buffer, uint16_t space)
+    description:    writes a value as a varint
+    arguments:      value
+                        - value to write
+                    buffer
+                        - pointer to write to
+                    space
+                        - bytes available at buffer
+    returns:        number of bytes written, or 0 if there isn't space
+*/
+uint8_t cryo_codec_put_varint(uint32_t value, uint8_t* buffer, uint16_t space);
+
+/*
+    name:           cryo_codec_get_varint(const uint8_t* buffer, uint16_t length, uint32_t* value)
+    description:    reads a varint
+    arguments:      buffer
+                        - pointer to read from
+                    length
+                        - bytes available at buffer
+                    value
+                        - pointer to store the value
+    returns:        number of bytes read, or 0 if the varint is truncated or too long
+*/
+uint8_t cryo_codec_get_varint(const uint8_t* buffer, uint16_t length, uint32_t* value);
+
+/*
+    name:           cryo_codec_delta_init(cryo_codec_delta* codec, uint8_t fields)
+    description:    prepares a delta encoder or decoder for readings of the given 
+                    number of fields.  The first reading is sent relative to zero.
+    arguments:      codec
+                        - encoder or decoder to initialise
+                    fields
+                        - number of fields per reading, up to CRYO_CODEC_MAX_FIELDS
+    returns:        false if fields is out of range
+*/
+bool cryo_codec_delta_init(cryo_codec_delta* codec, uint8_t fields);
+
+/*
+    name:           cryo_codec_delta_encode(cryo_codec_delta* codec, const int32_t* values, uint8_t* buffer, uint16_t space)
+    description:    encodes one reading.  If it doesn't fit, nothing is written and 
+                    the encoder is unchanged, so the reading can be encoded again
+                    into a new buffer.
+    arguments:      codec
+                        - encoder
+                    values
+                        - pointer to one value per field
+                    buffer
+                        - pointer to write to
+                    space
+                        - bytes available at buffer
+    returns:        number of bytes written, or 0 if there isn't space
+*/
+uint16_t cryo_codec_delta_encode(cryo_codec_delta* codec, const int32_t* values, uint8_t* buffer, uint16_t space);
+
+/*
+    name:           cryo_codec_delta_decode(cryo_codec_delta* codec, const uint8_t* buffer, uint16_t length, int32_t* values)
+    description:    decodes one reading
+    arguments:      codec
+                        - decoder
+                    buffer
+                        - pointer to read from
+                    length
+                        - bytes available at buffer
+                    values
+                        - pointer to store one value per field
+    returns:        number of bytes read, or 0 if the reading is truncated
+*/
+uint16_t cryo_codec_delta_decode(cryo_codec_delta* codec, const uint8_t* buffer, uint16_t length, int32_t* values);
+
+/*
+    name:           cryo_codec_xor_init(cryo_codec_xor* codec)
+    description:    prepares an XOR float encoder or decoder
+    arguments:      codec
+                        - encoder or decoder to initialise
+    returns:        none
+*/
+void cryo_codec_xor_init(cryo_codec_xor* codec);
+
+/*
+    name:           cryo_codec_xor_encode(cryo_codec_xor* codec, float_t value, uint8_t* buffer, uint16_t space)
+    description:    encodes a float as a header byte (number of leading and trailing
+                    bytes that match the previous value) followed by the bytes that 
+                    differ.  A repeated value takes one byte.
+    arguments:      codec
+                        - encoder
+                    value
+                        - value to encode
+                    buffer
+                        - pointer to write to
+                    space
+                        - bytes available at buffer
+    returns:        number of bytes written, or 0 if there isn't space
+*/
+uint8_t cryo_codec_xor_encode(cryo_codec_xor* codec, float_t value, uint8_t* buffer, uint16_t space);
+
+/*
+    name:           cryo_codec_xor_decode(cryo_codec_xor* codec, const uint8_t* buffer, uint16_t length, float_t* value)
+    description:    decodes a float written by cryo_codec_xor_encode()
+    arguments:      codec
+                        - decoder
+                    buffer
+                        - pointer to read from
+                    length
+                        - bytes available at buffer
+                    value
+                        - pointer to store the value
+    returns:        number of bytes read, or 0 if the value is truncated or invalid
+*/
+uint8_t cryo_codec_xor_decode(cryo_codec_xor* codec, const uint8_t* buffer, uint16_t length, float_t* value);
+
+#endif
@@ -0,0 +1,300 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+*****************************************************************************/
+
+#include "cryo_dsp.h"
+
+int16_t dsp_saturate(int32_t value) {
+  if (value > INT16_MAX) return INT16_MAX;
+  if (value < INT16_MIN) return INT16_MIN;
+  return (int16_t) value;
+}
+
+void cryo_dsp_decimator_init(cryo_dsp_decimator* decimator, uint8_t extra_bits) {
+
+  if (extra_bits > CRYO_DSP_MAX_EXTRA_BITS)
+    extra_bits = CRYO_DSP_MAX_EXTRA_BITS;
+  decimator->extra_bits = extra_bits;
+  decimator->length = 1ul << (2 * extra_bits);
+  cryo_dsp_decimator_reset(decimator);
+
+}
+
+void cryo_dsp_decimator_reset(cryo_dsp_decimator* decimator) {
+
+  decimator->sum = 0;
+  decimator->sum_squares = 0;
+  decimator->min = INT16_MAX;
+  decimator->max = INT16_MIN;
+  decimator->count = 0;
+
+}
+
+uint16_t cryo_dsp_decimator_add(cryo_dsp_decimator* decimator, const int16_t* samples, uint16_t count) {
+
+  uint32_t remaining = decimator->length - decimator->count;
+  if (count > remaining)
+    count = remaining;
+
+  // Accumulate in locals so the loop stays in registers
+  int32_t sum = decimator->sum;
+  uint64_t sum_squares = decimator->sum_squares;
+  int16_t min = decimator->min;
+  int16_t max = decimator->max;
+
+  for (uint16_t k = 0; k < count; k++) {
+    int16_t sample = samples[k];
+    sum += sample;
+    sum_squares += (uint32_t) ((int32_t) sample * sample);
+    if (sample < min) min = sample;
+    if (sample > max) max = sample;
+  }
+
+  decimator->sum = sum;
+  decimator->sum_squares = sum_squares;
+  decimator->min = min;
+  decimator->max = max;
+  decimator->count += count;
+
+  return count;
+
+}
+
+bool cryo_dsp_decimator_ready(cryo_dsp_decimator* decimator) {
+  return decimator->count >= decimator->length;
+}
+
+bool cryo_dsp_decimator_result(cryo_dsp_decimator* decimator, cryo_dsp_statistics* statistics) {
+
+  uint32_t count = decimator->count;
+  if (count == 0)
+    return false;
+
+  // Mean scaled by 2^extra_bits, rounded.  With 4^extra_bits samples this is 
+  // the sum shifted right by extra_bits.
+  int64_t scaled = (int64_t) decimator->sum << decimator->extra_bits;
+  int64_t half = count / 2;
+  statistics->mean = (int32_t) ((scaled >= 0 ? scaled + half : scaled - half) / (int64_t) count);
+  statistics->extra_bits = decimator->extra_bits;
+
+  // Variance = (sum of squares - sum^2 / N) / N, in 1/256 counts squared.
+  // sum^2 < 2^62, so it's divided by N before scaling, keeping the remainder.
+  uint64_t sum_squared = (uint64_t) ((int64_t) decimator->sum * decimator->sum);
+  uint64_t sum_squared_mean = ((sum_squared / count) << 8) + ((sum_squared % count) << 8) / count;
+  uint64_t variance = ((decimator->sum_squares << 8) - sum_squared_mean) / count;
+  statistics->variance = variance > UINT32_MAX ? UINT32_MAX : (uint32_t) variance;
+
+  statistics->min = decimator->min;
+  statistics->max = decimator->max;
+  statistics->count = count;
+
+  cryo_dsp_decimator_reset(decimator);
+  return true;
+
+}
+
+bool cryo_dsp_decimate(ADCDifferential* adc, uint8_t extra_bits, cryo_dsp_statistics* statistics) {
+
+  if (extra_bits > CRYO_DSP_MAX_EXTRA_BITS)
+    return false;
+
+  cryo_dsp_decimator decimator;
+  cryo_dsp_decimator_init(&decimator, extra_bits);
+  while (!cryo_dsp_decimator_ready(&decimator)) {
+    int16_t sample = adc->read();
+    cryo_dsp_decimator_add(&decimator, &sample, 1);
+  }
+  return cryo_dsp_decimator_result(&decimator, statistics);
+
+}
+
+bool cryo_dsp_fir_init(cryo_dsp_fir* fir, const int16_t* coefficients, uint8_t taps, int16_t* history) {
+
+  if (taps == 0 || taps > CRYO_DSP_FIR_MAX_TAPS)
+    return false;
+
+  fir->coefficients = coefficients;
+  fir->history = history;
+  fir->taps = taps;
+  for (uint8_t k = 0; k + 1 < taps; k++)
+    history[k] = 0;
+  return true;
+
+}
+
+void cryo_dsp_fir_process(cryo_dsp_fir* fir, int16_t* samples, uint16_t count) {
+
+  if (count == 0)
+    return;
+
+  const int16_t* c = fir->coefficients;
+  int16_t* history = fir->history;
+  uint8_t order = fir->taps - 1;
+
+  // Keep the inputs that become the next history, as they are overwritten below
+  int16_t next_history[CRYO_DSP_FIR_MAX_TAPS];
+  for (uint8_t k = 0; k < order; k++) {
+    // history[0] is the most recent input
+    next_history[k] = k < count ? samples[count - 1 - k] : history[k - count];
+  }
+
+  // Working from the end of the buffer means each output only overwrites an 
+  // input that no earlier output needs, so no copy of the buffer is required
+  for (int32_t n = count - 1; n >= 0; n--) {
+    // Up to CRYO_DSP_FIR_MAX_TAPS products of 2^30 may exceed 32 bits, but
+    // once scaled back the sum fits in 32 bits for dsp_saturate()
+    int64_t accumulator = 0;
+    for (uint8_t k = 0; k <= order; k++) {
+      int32_t index = n - k;
+      int16_t x = index >= 0 ? samples[index] : history[-index - 1];
+      accumulator += (int32_t) c[k] * x;
+    }
+    samples[n] = dsp_saturate((int32_t) ((accumulator + (1l << 14)) >> 15));
+  }
+
+  for (uint8_t k = 0; k < order; k++)
+    history[k] = next_history[k];
+
+}
+
+void cryo_dsp_biquad_init(cryo_dsp_biquad* biquad, int16_t b0, int16_t b1, int16_t b2, int16_t a1, int16_t a2) {
+
+  biquad->b0 = b0;
+  biquad->b1 = b1;
+  biquad->b2 = b2;
+  biquad->a1 = a1;
+  biquad->a2 = a2;
+  biquad->x1 = biquad->x2 = 0;
+  biquad->y1 = biquad->y2 = 0;
+
+}
+
+void cryo_dsp_biquad_process(cryo_dsp_biquad* biquad, int16_t* samples, uint16_t count) {
+
+  int16_t x1 = biquad->x1, x2 = biquad->x2;
+  int16_t y1 = biquad->y1, y2 = biquad->y2;
+
+  for (uint16_t n = 0; n < count; n++) {
+    int16_t x = samples[n];
+    // Each product fits in 32 bits, but their sum may not
+    int64_t accumulator = 
+      (int32_t) biquad->b0 * x + 
+      (int64_t) ((int32_t) biquad->b1 * x1) + 
+      (int64_t) ((int32_t) biquad->b2 * x2) - 
+      (int64_t) ((int32_t) biquad->a1 * y1) - 
+      (int64_t) ((int32_t) biquad->a2 * y2);
+    int64_t y = (accumulator + (1l << 13)) >> 14;
+    int16_t output = y > INT16_MAX ? INT16_MAX : (y < INT16_MIN ? INT16_MIN : (int16_t) y);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = output;
+    samples[n] = output;
+  }
+
+  biquad->x1 = x1;
+  biquad->x2 = x2;
+  biquad->y1 = y1;
+  biquad->y2 = y2;
+
+}
+
+bool cryo_dsp_median_init(cryo_dsp_median* median, uint8_t window) {
+
+  if (window == 0 || window > CRYO_DSP_MEDIAN_MAX_WINDOW || window % 2 == 0)
+    return false;
+
+  median->window = window;
+  median->index = 0;
+  median->filled = 0;
+  return true;
+
+}
+
+void cryo_dsp_median_process(cryo_dsp_median* median, int16_t* samples, uint16_t count) {
+
+  int16_t* sorted = median->sorted;
+
+  for (uint16_t n = 0; n < count; n++) {
+    int16_t x = samples[n];
+    uint8_t length = median->filled;
+
+    // Drop the oldest sample from the sorted list once the window is full
+    if (length == median->window) {
+      int16_t oldest = median->ring[median->index];
+      uint8_t k = 0;
+      while (sorted[k] != oldest) k++;
+      for (; k + 1 < length; k++)
+        sorted[k] = sorted[k + 1];
+      length--;
+    }
+
+    // Insertion sort the new sample
+    uint8_t k = length;
+    while (k > 0 && sorted[k - 1] > x) {
+      sorted[k] = sorted[k - 1];
+      k--;
+    }
+    sorted[k] = x;
+    length++;
+
+    median->ring[median->index] = x;
+    median->index = median->index + 1 == median->window ? 0 : median->index + 1;
+    median->filled = length;
+
+    samples[n] = sorted[length / 2];
+  }
+
+}
+
+void cryo_dsp_exponential_init(cryo_dsp_exponential* exponential, uint8_t shift) {
+
+  exponential->state = 0;
+  exponential->shift = shift > 15 ? 15 : shift;
+  exponential->primed = false;
+
+}
+
+void cryo_dsp_exponential_process(cryo_dsp_exponential* exponential, int16_t* samples, uint16_t count) {
+
+  if (count == 0)
+    return;
+
+  if (!exponential->primed) {
+    exponential->state = (int32_t) samples[0] << 15;
+    exponential->primed = true;
+  }
+
+  int32_t state = exponential->state;
+  uint8_t shift = exponential->shift;
+  for (uint16_t n = 0; n < count; n++) {
+    // The difference needs at most 31 bits with 15 fractional bits
+    state += (((int32_t) samples[n] << 15) - state) >> shift;
+    samples[n] = (int16_t) ((state + (1l << 14)) >> 15);
+  }
+  exponential->state = state;
+
+}
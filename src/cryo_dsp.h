@@ -0,0 +1,338 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+FILE: 
+    cryo_dsp.h
+
+DESCRIPTION: 
+    Integer signal processing for ADC results.  The decimator accumulates
+    bursts of samples (e.g. from ADCDifferential::read() or the buffers 
+    filled by ADCDifferential::start_stream()) to give an oversampled mean 
+    with extra bits of resolution, along with the variance, minimum and 
+    maximum of the samples.
+
+    The filter kernels (FIR, biquad IIR, moving median and exponential 
+    smoothing) process a whole buffer of int16_t samples in place per call, 
+    keeping their state between calls so consecutive buffers (e.g. each half
+    of a stream buffer) are filtered as one continuous signal.
+
+    Oversampling by 4^n gives n extra bits, provided the samples carry at 
+    least 1 LSB of noise.  Hardware averaging (ADCDifferential::set_averages()) 
+    can be combined with it, but the variance is then that of the averaged 
+    results.
+
+EXAMPLE USAGE:
+
+    #include "cryo_adc.h"
+    #include "cryo_dsp.h"
+
+    cryo_dsp_decimator decimator;
+    cryo_dsp_statistics stats;
+
+    void stream_callback(int16_t* samples, uint16_t count) {
+        cryo_dsp_decimator_add(&decimator, samples, count);
+    }
+
+    void setup() {
+        // 4^4 = 256 samples for 4 extra bits
+        cryo_dsp_decimator_init(&decimator, 4);
+        ...
+    }
+
+    void loop() {
+        if (cryo_dsp_decimator_ready(&decimator)) {
+            cryo_dsp_decimator_result(&decimator, &stats);
+            Serial.printf("Mean: %d/16, variance: %u/256\n\r", stats.mean, stats.variance);
+        }
+    }
+
+*/
+#include <Arduino.h>
+#include "cryo_adc.h"
+
+#ifndef CRYO_DSP_H
+#define CRYO_DSP_H
+
+// 4^8 = 65536 samples, the most that can be summed in 32 bits
+#define CRYO_DSP_MAX_EXTRA_BITS 8
+
+// Largest FIR filter, which sets the stack used while filtering
+#ifndef CRYO_DSP_FIR_MAX_TAPS
+#define CRYO_DSP_FIR_MAX_TAPS 32
+#endif
+
+// Largest moving median window
+#ifndef CRYO_DSP_MEDIAN_MAX_WINDOW
+#define CRYO_DSP_MEDIAN_MAX_WINDOW 15
+#endif
+
+/*
+    Decimator state.  The sum holds up to 65536 16-bit samples without
+    overflowing, and the sum of squares up to 2^46.
+*/
+typedef struct cryo_dsp_decimator {
+    int32_t sum;
+    uint64_t sum_squares;
+    int16_t min;
+    int16_t max;
+    uint32_t count;
+    // Samples required for the requested extra bits (4^extra_bits)
+    uint32_t length;
+    uint8_t extra_bits;
+} cryo_dsp_decimator;
+
+typedef struct cryo_dsp_statistics {
+    // Mean scaled by 2^extra_bits
+    int32_t mean;
+    uint8_t extra_bits;
+    // Variance of the samples, in 1/256 counts squared (saturates above 2^24 counts squared)
+    uint32_t variance;
+    int16_t min;
+    int16_t max;
+    uint32_t count;
+} cryo_dsp_statistics;
+
+/*
+    FIR filter.  Coefficients are Q15 (32767 = 1.0) and the history holds the
+    last (taps - 1) input samples, both supplied by the caller.  The output is
+    guaranteed not to overflow if the magnitudes of the coefficients sum to 
+    no more than 1.0, as for typical low-pass filters; otherwise it saturates.
+*/
+typedef struct cryo_dsp_fir {
+    const int16_t* coefficients;
+    int16_t* history;
+    uint8_t taps;
+} cryo_dsp_fir;
+
+/*
+    Biquad (second order IIR) filter in direct form I, with Q14 coefficients 
+    (16384 = 1.0) so that a1 can reach -2.0:
+
+        y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+
+    Higher order filters can be built by running several stages in turn.
+*/
+typedef struct cryo_dsp_biquad {
+    int16_t b0, b1, b2, a1, a2;
+    int16_t x1, x2, y1, y2;
+} cryo_dsp_biquad;
+
+/*
+    Moving median over an odd window of up to CRYO_DSP_MEDIAN_MAX_WINDOW 
+    samples, which rejects spikes without smearing steps.
+*/
+typedef struct cryo_dsp_median {
+    // Samples in arrival order (ring buffer) and in sorted order
+    int16_t ring[CRYO_DSP_MEDIAN_MAX_WINDOW];
+    int16_t sorted[CRYO_DSP_MEDIAN_MAX_WINDOW];
+    uint8_t window;
+    uint8_t index;
+    uint8_t filled;
+} cryo_dsp_median;
+
+/*
+    Exponential smoothing, y += (x - y) / 2^shift.  The state has 15 
+    fractional bits so small steps aren't lost to rounding.
+*/
+typedef struct cryo_dsp_exponential {
+    int32_t state;
+    uint8_t shift;
+    bool primed;
+} cryo_dsp_exponential;
+
+/*
+    name:           cryo_dsp_decimator_init(cryo_dsp_decimator* decimator, uint8_t extra_bits)
+    description:    prepares a decimator to collect 4^extra_bits samples
+    arguments:      decimator
+                        - decimator to initialise
+                    extra_bits
+                        - bits of resolution to add, up to CRYO_DSP_MAX_EXTRA_BITS
+    returns:        nothing
+*/
+void cryo_dsp_decimator_init(cryo_dsp_decimator* decimator, uint8_t extra_bits);
+
+/*
+    name:           cryo_dsp_decimator_reset(cryo_dsp_decimator* decimator)
+    description:    discards any samples collected, keeping the number of extra bits
+    arguments:      decimator
+                        - decimator to reset
+    returns:        nothing
+*/
+void cryo_dsp_decimator_reset(cryo_dsp_decimator* decimator);
+
+/*
+    name:           cryo_dsp_decimator_add(cryo_dsp_decimator* decimator, const int16_t* samples, uint16_t count)
+    description:    adds samples to the decimator, stopping once it has enough
+    arguments:      decimator
+                        - decimator to add to
+                    samples
+                        - pointer to the samples
+                    count
+                        - number of samples
+    returns:        number of samples used, which is less than count if the 
+                    decimator became ready part way through
+*/
+uint16_t cryo_dsp_decimator_add(cryo_dsp_decimator* decimator, const int16_t* samples, uint16_t count);
+
+/*
+    name:           cryo_dsp_decimator_ready(cryo_dsp_decimator* decimator)
+    description:    checks whether the decimator has collected 4^extra_bits samples
+    arguments:      decimator
+                        - decimator to check
+    returns:        true if the decimator is ready
+*/
+bool cryo_dsp_decimator_ready(cryo_dsp_decimator* decimator);
+
+/*
+    name:           cryo_dsp_decimator_result(cryo_dsp_decimator* decimator, cryo_dsp_statistics* statistics)
+    description:    calculates the statistics of the samples collected and resets the 
+                    decimator.  Can be called before the decimator is ready, in which 
+                    case the mean still carries extra_bits of scaling but not 
+                    the full resolution.
+    arguments:      decimator
+                        - decimator to take the result from
+                    statistics
+                        - pointer to the statistics to fill in
+    returns:        false if no samples had been collected
+*/
+bool cryo_dsp_decimator_result(cryo_dsp_decimator* decimator, cryo_dsp_statistics* statistics);
+
+/*
+    name:           cryo_dsp_decimate(ADCDifferential* adc, uint8_t extra_bits, cryo_dsp_statistics* statistics)
+    description:    reads 4^extra_bits results from the ADC and decimates them
+    arguments:      adc
+                        - pointer to ADCDifferential object to read
+                    extra_bits
+                        - bits of resolution to add, up to CRYO_DSP_MAX_EXTRA_BITS.
+                          ADCDifferential::get_conversion_time_us() gives the time per sample.
+                    statistics
+                        - pointer to the statistics to fill in
+    returns:        false if extra_bits is out of range
+*/
+bool cryo_dsp_decimate(ADCDifferential* adc, uint8_t extra_bits, cryo_dsp_statistics* statistics);
+
+/*
+    name:           cryo_dsp_fir_init(cryo_dsp_fir* fir, const int16_t* coefficients, uint8_t taps, int16_t* history)
+    description:    prepares an FIR filter, clearing its history
+    arguments:      fir
+                        - filter to initialise
+                    coefficients
+                        - pointer to taps Q15 coefficients, which must stay valid
+                    taps
+                        - number of coefficients, up to CRYO_DSP_FIR_MAX_TAPS
+                    history
+                        - pointer to (taps - 1) samples of storage for the filter history
+    returns:        false if taps is out of range
+*/
+bool cryo_dsp_fir_init(cryo_dsp_fir* fir, const int16_t* coefficients, uint8_t taps, int16_t* history);
+
+/*
+    name:           cryo_dsp_fir_process(cryo_dsp_fir* fir, int16_t* samples, uint16_t count)
+    description:    filters a buffer in place
+    arguments:      fir
+                        - filter to apply
+                    samples
+                        - pointer to the samples, overwritten with the filtered samples
+                    count
+                        - number of samples
+    returns:        nothing
+*/
+void cryo_dsp_fir_process(cryo_dsp_fir* fir, int16_t* samples, uint16_t count);
+
+/*
+    name:           cryo_dsp_biquad_init(cryo_dsp_biquad* biquad, int16_t b0, int16_t b1, int16_t b2, int16_t a1, int16_t a2)
+    description:    prepares a biquad filter, clearing its state
+    arguments:      biquad
+                        - filter to initialise
+                    b0, b1, b2, a1, a2
+                        - Q14 coefficients, with a0 normalised to 1.0
+    returns:        nothing
+*/
+void cryo_dsp_biquad_init(cryo_dsp_biquad* biquad, int16_t b0, int16_t b1, int16_t b2, int16_t a1, int16_t a2);
+
+/*
+    name:           cryo_dsp_biquad_process(cryo_dsp_biquad* biquad, int16_t* samples, uint16_t count)
+    description:    filters a buffer in place, saturating the output to 16 bits
+    arguments:      biquad
+                        - filter to apply
+                    samples
+                        - pointer to the samples, overwritten with the filtered samples
+                    count
+                        - number of samples
+    returns:        nothing
+*/
+void cryo_dsp_biquad_process(cryo_dsp_biquad* biquad, int16_t* samples, uint16_t count);
+
+/*
+    name:           cryo_dsp_median_init(cryo_dsp_median* median, uint8_t window)
+    description:    prepares a moving median filter.  Until the window has filled, 
+                    the output is the median of the samples seen so far.
+    arguments:      median
+                        - filter to initialise
+                    window
+                        - number of samples, odd and up to CRYO_DSP_MEDIAN_MAX_WINDOW
+    returns:        false if window is out of range or even
+*/
+bool cryo_dsp_median_init(cryo_dsp_median* median, uint8_t window);
+
+/*
+    name:           cryo_dsp_median_process(cryo_dsp_median* median, int16_t* samples, uint16_t count)
+    description:    filters a buffer in place
+    arguments:      median
+                        - filter to apply
+                    samples
+                        - pointer to the samples, overwritten with the filtered samples
+                    count
+                        - number of samples
+    returns:        nothing
+*/
+void cryo_dsp_median_process(cryo_dsp_median* median, int16_t* samples, uint16_t count);
+
+/*
+    name:           cryo_dsp_exponential_init(cryo_dsp_exponential* exponential, uint8_t shift)
+    description:    prepares an exponential smoothing filter.  The state starts at 
+                    the first sample processed.
+    arguments:      exponential
+                        - filter to initialise
+                    shift
+                        - smoothing factor as a power of two (alpha = 1 / 2^shift), up to 15
+    returns:        nothing
+*/
+void cryo_dsp_exponential_init(cryo_dsp_exponential* exponential, uint8_t shift);
+
+/*
+    name:           cryo_dsp_exponential_process(cryo_dsp_exponential* exponential, int16_t* samples, uint16_t count)
+    description:    filters a buffer in place
+    arguments:      exponential
+                        - filter to apply
+                    samples
+                        - pointer to the samples, overwritten with the filtered samples
+                    count
+                        - number of samples
+    returns:        nothing
+*/
+void cryo_dsp_exponential_process(cryo_dsp_exponential* exponential, int16_t* samples, uint16_t count);
+
+#endif
@@ -30,6 +30,9 @@ SOFTWARE.
 // Initialise ina3221 object
 INA3221 ina3221(INA3221_ADDR40_GND);
 
+cryo_power_snapshot power_snapshot;
+bool power_snapshot_valid = false;
+
 int32_t cryo_power_init() {
 
     ina3221.begin();
@@ -81,4 +84,34 @@ float_t cryo_power_load_voltage() {
 
 float_t cryo_power_load_current() {
     return (float_t) ina3221.getCurrent(CRYO_POWER_LOAD_CHANNEL);
-}
\ No newline at end of file
+}
+
+void cryo_power_sample() {
+
+    // Read back to back so the values are as close together as possible
+    power_snapshot.battery_voltage = cryo_power_battery_voltage();
+    power_snapshot.battery_current = cryo_power_battery_current();
+    power_snapshot.solar_panel_voltage = cryo_power_solar_panel_voltage();
+    power_snapshot.solar_panel_current = cryo_power_solar_panel_current();
+    power_snapshot.load_voltage = cryo_power_load_voltage();
+    power_snapshot.load_current = cryo_power_load_current();
+    power_snapshot.epoch = cryo_get_rtc()->get_epoch();
+    power_snapshot_valid = true;
+
+}
+
+void cryo_power_get_snapshot(cryo_power_snapshot* snapshot, uint32_t max_age) {
+
+    uint32_t now = cryo_get_rtc()->get_epoch();
+    // A snapshot from the future means the clock has been set back
+    if (
+        !power_snapshot_valid || 
+        max_age == 0 || 
+        now < power_snapshot.epoch || 
+        now - power_snapshot.epoch > max_age
+    ) {
+        cryo_power_sample();
+    }
+    *snapshot = power_snapshot;
+
+}
@@ -33,6 +33,10 @@ DESCRIPTION:
     Provides wrappers functions for initialising the INA3221 and reading power
     and current measurements from the battery, solar panel and circuit.
 
+    cryo_power_sample() reads all six measurements together into a 
+    timestamped snapshot, which cryo_power_get_snapshot() returns without
+    touching the I2C bus until it is older than the caller allows.
+
 CONFIGURATION:
     
 
@@ -40,6 +44,7 @@ EXAMPLE USAGE:
 */
 #include <Arduino.h>
 #include "INA3221.h"
+#include "cryo_sleep.h"
 
 #ifndef CYRO_POWER_H
 #define CRYO_POWER_H
@@ -51,6 +56,22 @@ EXAMPLE USAGE:
 #define CRYO_POWER_PANEL_CHANNEL INA3221_CH2
 #define CRYO_POWER_LOAD_CHANNEL INA3221_CH3
 
+/*
+    Housekeeping Snapshot
+    ---------------------
+    All six measurements, read one after the other, with the time they were 
+    read as seconds since 1970 (PseudoRTC::get_epoch()).
+*/
+typedef struct cryo_power_snapshot {
+    uint32_t epoch;
+    float_t battery_voltage;
+    float_t battery_current;
+    float_t solar_panel_voltage;
+    float_t solar_panel_current;
+    float_t load_voltage;
+    float_t load_current;
+} cryo_power_snapshot;
+
 /*
     name:           cryo_power_init()
     description:    initialises the INA3221 power monitor circuitry and I2C interface.
@@ -111,4 +132,26 @@ float_t cryo_power_solar_panel_current();
 */
 float_t cryo_power_load_current();
 
+/*
+    name:           cryo_power_sample()
+    description:    reads the voltage and current of every channel into the 
+                    housekeeping snapshot, e.g. from an alarm ahead of sending
+    arguments:      none
+    returns:        none
+*/
+void cryo_power_sample();
+
+/*
+    name:           cryo_power_get_snapshot(cryo_power_snapshot* snapshot, uint32_t max_age)
+    description:    copies the housekeeping snapshot, taking a new one first if 
+                    it is older than max_age seconds (or there isn't one)
+    arguments:      snapshot
+                        - pointer to the snapshot to fill in
+                    max_age
+                        - oldest snapshot to accept in seconds, or 0 to always
+                          take a new one
+    returns:        none
+*/
+void cryo_power_get_snapshot(cryo_power_snapshot* snapshot, uint32_t max_age);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+*****************************************************************************/
+
+#include "cryo_pt1000.h"
+
+// Callendar-Van Dusen coefficients (IEC 60751)
+#define PT1000_CVD_A 3.9083e-3
+#define PT1000_CVD_B -5.775e-7
+#define PT1000_CVD_C -4.183e-12
+
+// Resistance in milliohms at t degrees C, evaluated by the compiler.  The C
+// term only applies below 0 degrees C.
+constexpr int32_t pt1000_cvd_milliohms(double t) {
+  return (int32_t) (CRYO_PT1000_R0 * 1000.0 * (
+    1.0 + PT1000_CVD_A * t + PT1000_CVD_B * t * t 
+    + (t < 0 ? PT1000_CVD_C * (t - 100.0) * t * t * t : 0.0)
+  ) + 0.5);
+}
+
+#define PT1000_CVD(t) pt1000_cvd_milliohms(t)
+
+// Resistance at each table point, from CRYO_PT1000_TABLE_MIN in steps of CRYO_PT1000_TABLE_STEP
+constexpr int32_t pt1000_table[] = {
+  PT1000_CVD(-200), PT1000_CVD(-195), PT1000_CVD(-190), PT1000_CVD(-185), PT1000_CVD(-180), PT1000_CVD(-175),
+  PT1000_CVD(-170), PT1000_CVD(-165), PT1000_CVD(-160), PT1000_CVD(-155), PT1000_CVD(-150), PT1000_CVD(-145),
+  PT1000_CVD(-140), PT1000_CVD(-135), PT1000_CVD(-130), PT1000_CVD(-125), PT1000_CVD(-120), PT1000_CVD(-115),
+  PT1000_CVD(-110), PT1000_CVD(-105), PT1000_CVD(-100), PT1000_CVD(-95), PT1000_CVD(-90), PT1000_CVD(-85),
+  PT1000_CVD(-80), PT1000_CVD(-75), PT1000_CVD(-70), PT1000_CVD(-65), PT1000_CVD(-60), PT1000_CVD(-55),
+  PT1000_CVD(-50), PT1000_CVD(-45), PT1000_CVD(-40), PT1000_CVD(-35), PT1000_CVD(-30), PT1000_CVD(-25),
+  PT1000_CVD(-20), PT1000_CVD(-15), PT1000_CVD(-10), PT1000_CVD(-5), PT1000_CVD(0), PT1000_CVD(5),
+  PT1000_CVD(10), PT1000_CVD(15), PT1000_CVD(20), PT1000_CVD(25), PT1000_CVD(30), PT1000_CVD(35),
+  PT1000_CVD(40), PT1000_CVD(45), PT1000_CVD(50), PT1000_CVD(55), PT1000_CVD(60), PT1000_CVD(65),
+  PT1000_CVD(70), PT1000_CVD(75), PT1000_CVD(80), PT1000_CVD(85), PT1000_CVD(90), PT1000_CVD(95),
+  PT1000_CVD(100)
+};
+
+#define PT1000_TABLE_LENGTH (sizeof(pt1000_table) / sizeof(pt1000_table[0]))
+static_assert(
+  PT1000_TABLE_LENGTH == (CRYO_PT1000_TABLE_MAX - CRYO_PT1000_TABLE_MIN) / CRYO_PT1000_TABLE_STEP + 1,
+  "PT1000 table does not match its range"
+);
+
+int32_t cryo_pt1000_resistance_milliohms(
+  int32_t counts, 
+  ADCDifferential::GAIN gain, 
+  ADCDifferential::VOLTAGE_REFERENCE reference,
+  int32_t full_scale) {
+
+  // Voltage across the PT1000, with the gain doubled so GAIN_DIV2 is an integer
+  int64_t gain_x2 = ADCDifferential::convert_enum_to_gain_x2(gain);
+  int64_t microvolts = (int64_t) counts * ADCDifferential::reference_microvolts(reference) * 2 
+    / (full_scale * gain_x2);
+
+  // R = R_ref * V / (V_excitation - V), rejecting negative voltages and
+  // results too close to the excitation to fit in milliohms
+  int64_t remainder = (int64_t) CRYO_PT1000_EXCITATION_MICROVOLTS - microvolts;
+  if (microvolts < 0 || remainder <= 0)
+    return -1;
+  int64_t resistance = (int64_t) CRYO_PT1000_REFERENCE_RESISTOR * 1000 * microvolts / remainder;
+  if (resistance > INT32_MAX)
+    return -1;
+  return (int32_t) resistance;
+
+}
+
+int32_t cryo_pt1000_millidegrees(int32_t resistance) {
+
+  // Find the segment containing the resistance, using the end segments 
+  // outside the table
+  uint32_t low = 0;
+  uint32_t high = PT1000_TABLE_LENGTH - 1;
+  while (high - low > 1) {
+    uint32_t mid = (low + high) / 2;
+    if (resistance < pt1000_table[mid])
+      high = mid;
+    else
+      low = mid;
+  }
+
+  // Linear interpolation within the segment
+  int32_t span = pt1000_table[high] - pt1000_table[low];
+  return (CRYO_PT1000_TABLE_MIN + (int32_t) low * CRYO_PT1000_TABLE_STEP) * 1000
+    + (int32_t) ((int64_t) (resistance - pt1000_table[low]) * CRYO_PT1000_TABLE_STEP * 1000 / span);
+
+}
+
+int32_t cryo_pt1000_counts_to_millidegrees(
+  int32_t counts, 
+  ADCDifferential::GAIN gain, 
+  ADCDifferential::VOLTAGE_REFERENCE reference,
+  int32_t full_scale) {
+
+  int32_t resistance = cryo_pt1000_resistance_milliohms(counts, gain, reference, full_scale);
+  if (resistance < 0)
+    return INT32_MIN;
+  return cryo_pt1000_millidegrees(resistance);
+
+}
+
+int32_t cryo_pt1000_read_millidegrees(ADCDifferential* adc) {
+
+  ADCDifferential::config cfg = adc->get_config();
+  return cryo_pt1000_counts_to_millidegrees(
+    adc->read(),
+    cfg.gain,
+    cfg.reference,
+    ADCDifferential::full_scale_counts(cfg.resolution, cfg.averages)
+  );
+
+}
@@ -0,0 +1,140 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+FILE: 
+    cryo_pt1000.h
+
+DESCRIPTION: 
+    Converts ADCDifferential results from the PT1000 divider to temperature
+    without floating point maths.  The resistance is worked out from the 
+    divider and looked up in a Callendar-Van Dusen (IEC 60751) table, which 
+    is calculated by the compiler, with linear interpolation between points.
+
+CONFIGURATION:
+
+    CRYO_PT1000_REFERENCE_RESISTOR
+        description:    resistance in series with the PT1000, in Ohms
+    
+    CRYO_PT1000_EXCITATION_MICROVOLTS
+        description:    voltage across the reference resistor and PT1000 in series, 
+                        in microvolts (defaults to the supply voltage)
+
+    Both can be defined prior to including cryo_pt1000.h to match the circuit.
+
+EXAMPLE USAGE:
+
+    #include "cryo_adc.h"
+    #include "cryo_pt1000.h"
+
+    ADCDifferential pt1000_adc(
+        ADCDifferential::INPUT_PIN_POS::A1_PIN,
+        ADCDifferential::INPUT_PIN_NEG::A2_PIN,
+        ADCDifferential::GAIN_2X
+    );
+
+    void loop() {
+        int32_t temperature = cryo_pt1000_read_millidegrees(&pt1000_adc);
+        Serial.printf("PT1000: %d mC\n\r", temperature);
+    }
+
+*/
+#include <Arduino.h>
+#include "cryo_adc.h"
+
+#ifndef CRYO_PT1000_H
+#define CRYO_PT1000_H
+
+#ifndef CRYO_PT1000_REFERENCE_RESISTOR
+#define CRYO_PT1000_REFERENCE_RESISTOR 10000 // Ohms
+#endif
+
+#ifndef CRYO_PT1000_EXCITATION_MICROVOLTS
+#define CRYO_PT1000_EXCITATION_MICROVOLTS CRYO_ADC_VDD_MICROVOLTS
+#endif
+
+// Nominal resistance at 0 degrees C
+#define CRYO_PT1000_R0 1000 // Ohms
+
+// Range and spacing of the lookup table (degrees C)
+#define CRYO_PT1000_TABLE_MIN -200
+#define CRYO_PT1000_TABLE_MAX 100
+#define CRYO_PT1000_TABLE_STEP 5
+
+/*
+    name:           cryo_pt1000_resistance_milliohms(int32_t counts, ADCDifferential::GAIN gain, ADCDifferential::VOLTAGE_REFERENCE reference, int32_t full_scale)
+    description:    converts an ADC result measured across the PT1000 to its resistance
+    arguments:      counts
+                        - ADC result (e.g. from ADCDifferential::read())
+                    gain
+                        - ADC gain the result was measured with
+                    reference
+                        - ADC voltage reference the result was measured with
+                    full_scale
+                        - magnitude of a full scale result, see ADCDifferential::full_scale_counts()
+    returns:        resistance in milliohms, or -1 if the result is negative, at or above the
+                    excitation voltage, or too close to it for the resistance to fit in an int32_t
+*/
+int32_t cryo_pt1000_resistance_milliohms(
+    int32_t counts, 
+    ADCDifferential::GAIN gain, 
+    ADCDifferential::VOLTAGE_REFERENCE reference,
+    int32_t full_scale
+);
+
+/*
+    name:           cryo_pt1000_millidegrees(int32_t resistance)
+    description:    converts a PT1000 resistance to temperature.  Accurate to within 
+                    a few millidegrees from -200 to +100 degrees C, extrapolated
+                    linearly outside this range.
+    arguments:      resistance
+                        - PT1000 resistance in milliohms
+    returns:        temperature in millidegrees C
+*/
+int32_t cryo_pt1000_millidegrees(int32_t resistance);
+
+/*
+    name:           cryo_pt1000_counts_to_millidegrees(int32_t counts, ADCDifferential::GAIN gain, ADCDifferential::VOLTAGE_REFERENCE reference, int32_t full_scale)
+    description:    converts an ADC result measured across the PT1000 to temperature
+    arguments:      as cryo_pt1000_resistance_milliohms()
+    returns:        temperature in millidegrees C, or INT32_MIN if the result is out of range
+*/
+int32_t cryo_pt1000_counts_to_millidegrees(
+    int32_t counts, 
+    ADCDifferential::GAIN gain, 
+    ADCDifferential::VOLTAGE_REFERENCE reference,
+    int32_t full_scale
+);
+
+/*
+    name:           cryo_pt1000_read_millidegrees(ADCDifferential* adc)
+    description:    reads the ADC and converts the result to temperature, using the 
+                    gain, reference, resolution and averaging the ADC is configured with
+    arguments:      adc
+                        - pointer to ADCDifferential object connected across the PT1000
+    returns:        temperature in millidegrees C, or INT32_MIN if the result is out of range
+*/
+int32_t cryo_pt1000_read_millidegrees(ADCDifferential* adc);
+
+#endif
@@ -0,0 +1,358 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*****************************************************************************/
+
+#include "cryo_system.h"
+#include "cryo_queue.h"
+
+bool queue_ready = false;
+// Offsets of the oldest record and the end of the data file
+uint32_t queue_head = 0;
+uint32_t queue_tail = 0;
+uint32_t queue_records = 0;
+// Set when the head has moved since the index was last saved
+bool queue_index_dirty = false;
+
+uint8_t queue_crc8(const uint8_t* data, uint8_t length) {
+
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t b = 0; b < 8; b++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+
+}
+
+void queue_put_uint32(uint8_t* buffer, uint32_t value) {
+
+    for (uint8_t i = 0; i < 4; i++)
+        buffer[i] = value >> (8 * i);
+
+}
+
+uint32_t queue_get_uint32(const uint8_t* buffer) {
+
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < 4; i++)
+        value |= (uint32_t) buffer[i] << (8 * i);
+    return value;
+
+}
+
+// Head offset saved while the data file is being rebuilt from the copy
+#define QUEUE_INDEX_COMPACTING 0xffffffff
+
+// The index holds the head offset and its complement, so a damaged index 
+// reads as an empty one
+bool queue_save_index(uint32_t head) {
+
+    uint8_t index[8];
+    queue_put_uint32(index, head);
+    queue_put_uint32(index + 4, ~head);
+
+    // Overwritten in place (FILE_WRITE would append), so the index is never
+    // missing and the card isn't asked to free and allocate a cluster
+    File file = SD.open(CRYO_QUEUE_INDEX_FILENAME, O_RDWR | O_CREAT);
+    if (!file)
+        return false;
+    file.seek(0);
+    size_t written = file.write(index, sizeof(index));
+    file.close();
+    if (written != sizeof(index))
+        return false;
+    queue_index_dirty = false;
+    return true;
+
+}
+
+uint32_t queue_load_index() {
+
+    uint8_t index[8];
+    File file = SD.open(CRYO_QUEUE_INDEX_FILENAME, FILE_READ);
+    if (!file)
+        return 0;
+    int read = file.read(index, sizeof(index));
+    file.close();
+
+    uint32_t head = queue_get_uint32(index);
+    if (read != sizeof(index) || head != ~queue_get_uint32(index + 4))
+        return 0;
+    return head;
+
+}
+
+// Append the contents of one file, from offset onwards, to another
+bool queue_copy(const char* from, const char* to, uint32_t offset) {
+
+    File source = SD.open(from, FILE_READ);
+    if (!source)
+        return false;
+    File destination = SD.open(to, FILE_WRITE);
+    if (!destination) {
+        source.close();
+        return false;
+    }
+
+    bool ok = true;
+    uint8_t buffer[64];
+    source.seek(offset);
+    int read;
+    while (ok && (read = source.read(buffer, sizeof(buffer))) > 0)
+        ok = destination.write(buffer, read) == (size_t) read;
+    destination.close();
+    source.close();
+    return ok;
+
+}
+
+// Replace the data file with the copy made by queue_compact()
+bool queue_restore_copy() {
+
+    SD.remove(CRYO_QUEUE_DATA_FILENAME);
+    if (!queue_copy(CRYO_QUEUE_COPY_FILENAME, CRYO_QUEUE_DATA_FILENAME, 0))
+        return false;
+    queue_head = 0;
+    queue_save_index(queue_head);
+    SD.remove(CRYO_QUEUE_COPY_FILENAME);
+    return true;
+
+}
+
+// Drop the frames already sent from the start of the data file.  The SD 
+// library can only append, so the queued frames are copied out and back.
+// The index marks the point after which the copy is the only complete one.
+void queue_compact() {
+
+    SD.remove(CRYO_QUEUE_COPY_FILENAME);
+    if (!queue_copy(CRYO_QUEUE_DATA_FILENAME, CRYO_QUEUE_COPY_FILENAME, queue_head)) {
+        SD.remove(CRYO_QUEUE_COPY_FILENAME);
+        return;
+    }
+    if (!queue_save_index(QUEUE_INDEX_COMPACTING))
+        return;
+    uint32_t queued = queue_tail - queue_head;
+    if (!queue_restore_copy()) {
+        // Left for cryo_queue_init() to finish
+        queue_ready = false;
+        return;
+    }
+    queue_tail = queued;
+
+}
+
+// Find the records from the head to the end of the data file, completing
+// a record that was only partly written
+void queue_scan() {
+
+    queue_records = 0;
+    queue_tail = 0;
+
+    File file = SD.open(CRYO_QUEUE_DATA_FILENAME, FILE_READ);
+    if (!file) {
+        queue_head = 0;
+        return;
+    }
+    uint32_t size = file.size();
+    if (queue_head > size)
+        queue_head = size;
+
+    uint32_t start = queue_head;
+    uint32_t offset = queue_head;
+    while (offset < size) {
+        start = offset;
+        file.seek(offset);
+        int length = file.read();
+        if (length < 0)
+            break;
+        offset += CRYO_QUEUE_RECORD_HEADER_LENGTH + length;
+        queue_records++;
+    }
+
+    if (offset > size) {
+        // Complete the partial record, making sure its checksum doesn't match
+        // so that it is skipped when it reaches the head of the queue.  The 
+        // last byte is always padding, and flipping it changes the checksum 
+        // or the frame.
+        uint8_t record[CRYO_QUEUE_RECORD_HEADER_LENGTH + CRYO_QUEUE_MAX_FRAME_LENGTH];
+        uint16_t written = size - start;
+        uint16_t total = offset - start;
+        memset(record, 0, sizeof(record));
+        file.seek(start);
+        file.read(record, written);
+        if (queue_crc8(record + CRYO_QUEUE_RECORD_HEADER_LENGTH, record[0]) == record[5])
+            record[total - 1] ^= 1;
+        file.close();
+
+        file = SD.open(CRYO_QUEUE_DATA_FILENAME, FILE_WRITE);
+        if (file)
+            file.write(record + written, total - written);
+    }
+    file.close();
+    queue_tail = offset;
+
+}
+
+uint8_t cryo_queue_init() {
+
+    if (!SD.begin(SD_CHIP_SELECT)) {
+        CRYO_DEBUG_MESSAGE("Failed to init SD card for radio queue.");
+        queue_ready = false;
+        return 0;
+    }
+
+    queue_head = queue_load_index();
+    if (queue_head == QUEUE_INDEX_COMPACTING) {
+        // Power was lost while compacting - finish rebuilding from the copy
+        if (!queue_restore_copy()) {
+            queue_ready = false;
+            return 0;
+        }
+    } else {
+        // A copy left before the index was marked (or after it was cleared)
+        // isn't needed
+        SD.remove(CRYO_QUEUE_COPY_FILENAME);
+    }
+    queue_scan();
+    queue_ready = true;
+    return 1;
+
+}
+
+uint32_t cryo_queue_count() {
+
+    return queue_records;
+
+}
+
+uint8_t cryo_queue_push(uint32_t packet_id, const uint8_t* frame, uint8_t length) {
+
+    if (!queue_ready || length == 0)
+        return 0;
+
+    // Make room by dropping the oldest frames
+    while (
+        queue_records > 0 && 
+        queue_tail - queue_head + CRYO_QUEUE_RECORD_HEADER_LENGTH + length > CRYO_QUEUE_MAX_BYTES
+    ) {
+        cryo_queue_pop();
+    }
+    cryo_queue_sync();
+
+    // Written in one go, to keep the window for a partial record small
+    uint8_t record[CRYO_QUEUE_RECORD_HEADER_LENGTH + CRYO_QUEUE_MAX_FRAME_LENGTH];
+    record[0] = length;
+    queue_put_uint32(record + 1, packet_id);
+    record[5] = queue_crc8(frame, length);
+    memcpy(record + CRYO_QUEUE_RECORD_HEADER_LENGTH, frame, length);
+
+    File file = SD.open(CRYO_QUEUE_DATA_FILENAME, FILE_WRITE);
+    if (!file)
+        return 0;
+    size_t written = file.write(record, CRYO_QUEUE_RECORD_HEADER_LENGTH + length);
+    file.close();
+
+    if (written != (size_t) CRYO_QUEUE_RECORD_HEADER_LENGTH + length) {
+        // Tidy up whatever part of the record was written
+        queue_scan();
+        return 0;
+    }
+    queue_tail += written;
+    queue_records++;
+    return 1;
+
+}
+
+uint8_t cryo_queue_peek(uint32_t* packet_id, uint8_t* frame, uint8_t* length) {
+
+    while (queue_ready && queue_records > 0) {
+        File file = SD.open(CRYO_QUEUE_DATA_FILENAME, FILE_READ);
+        if (!file)
+            return 0;
+
+        uint8_t header[CRYO_QUEUE_RECORD_HEADER_LENGTH];
+        file.seek(queue_head);
+        int read = file.read(header, CRYO_QUEUE_RECORD_HEADER_LENGTH);
+        if (read != CRYO_QUEUE_RECORD_HEADER_LENGTH || header[0] > *length) {
+            file.close();
+            return 0;
+        }
+        read = file.read(frame, header[0]);
+        file.close();
+
+        if (read == header[0] && queue_crc8(frame, header[0]) == header[5]) {
+            *packet_id = queue_get_uint32(header + 1);
+            *length = header[0];
+            return 1;
+        }
+        // Damaged record
+        cryo_queue_pop();
+    }
+    return 0;
+
+}
+
+uint8_t cryo_queue_pop() {
+
+    if (!queue_ready || queue_records == 0)
+        return 0;
+
+    File file = SD.open(CRYO_QUEUE_DATA_FILENAME, FILE_READ);
+    if (!file)
+        return 0;
+    file.seek(queue_head);
+    int length = file.read();
+    file.close();
+    if (length < 0)
+        return 0;
+
+    queue_head += CRYO_QUEUE_RECORD_HEADER_LENGTH + length;
+    queue_records--;
+    queue_index_dirty = true;
+    if (queue_records == 0) {
+        // Start a fresh data file rather than let it grow forever.  The index
+        // must follow straight away, or the next frame would be skipped.
+        SD.remove(CRYO_QUEUE_DATA_FILENAME);
+        queue_head = 0;
+        queue_tail = 0;
+        queue_save_index(queue_head);
+    }
+
+    // Copying costs no more than the frames already sent, so the file stays
+    // within about twice the queued bytes even if the queue never empties
+    if (queue_head >= CRYO_QUEUE_COMPACT_BYTES && queue_head >= queue_tail - queue_head)
+        queue_compact();
+    return 1;
+
+}
+
+uint8_t cryo_queue_sync() {
+
+    if (!queue_ready || !queue_index_dirty)
+        return 1;
+    return queue_save_index(queue_head);
+
+}
@@ -0,0 +1,167 @@
+/*****************************************************************************
+
+MIT License
+
+Copyright (c) 2024 Cardiff University / cryoskills.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+FILE: 
+    cryo_queue.h
+
+DEPENDENCIES:
+    SD - https://www.arduino.cc/reference/en/libraries/sd/
+
+DESCRIPTION: 
+    Persistent first-in, first-out queue of radio frames on the SD card, 
+    so that frames which couldn't be sent survive until the link returns
+    (and across resets).
+
+    Frames are appended to CRYO_QUEUE_DATA_FILENAME as records of:
+
+        length                  8 bits      length of the frame
+        packet_id               32 bits     little-endian
+        checksum                8 bits      CRC-8 of the frame
+        frame                   length bytes
+
+    and the offset of the oldest record is kept in CRYO_QUEUE_INDEX_FILENAME.
+    The data file is deleted whenever the queue empties, to reclaim the space,
+    and compacted (through CRYO_QUEUE_COPY_FILENAME) once the frames already
+    sent take up CRYO_QUEUE_COMPACT_BYTES and more than the frames still 
+    queued, so it doesn't grow without bound on a link that never clears it.
+    If power is lost while writing, the partial record is completed when the 
+    queue is next initialised and then skipped, as its checksum won't match.
+    cryo_queue_pop() only moves the head in memory, to spare the card a write
+    per frame; cryo_queue_sync() saves it, so frames popped since the last 
+    sync (or while the index was being written) are sent again after a reset.
+
+CONFIGURATION:
+    CRYO_QUEUE_MAX_BYTES
+        description:    most bytes held in the queue, after which the oldest
+                        frames are dropped
+        default value:  4 MB
+
+    CRYO_QUEUE_COMPACT_BYTES
+        description:    bytes of frames already sent at the start of the data
+                        file before it is compacted
+        default value:  64 kB
+
+EXAMPLE USAGE:
+
+    cryo_queue_init();
+    cryo_queue_push(packet_id, frame, frame_length);
+
+    // later, oldest first
+    uint32_t packet_id;
+    uint8_t frame[CRYO_QUEUE_MAX_FRAME_LENGTH];
+    uint8_t length = sizeof(frame);
+    while (cryo_queue_peek(&packet_id, frame, &length)) {
+        if (!send(frame, length))
+            break;
+        cryo_queue_pop();
+        length = sizeof(frame);
+    }
+    cryo_queue_sync();
+
+*/
+#include <Arduino.h>
+
+#ifndef CRYO_QUEUE_H
+#define CRYO_QUEUE_H
+
+#define CRYO_QUEUE_DATA_FILENAME "/RADIOQ.DAT"
+#define CRYO_QUEUE_INDEX_FILENAME "/RADIOQ.IDX"
+#define CRYO_QUEUE_COPY_FILENAME "/RADIOQ.TMP"
+
+#ifndef CRYO_QUEUE_MAX_BYTES
+#define CRYO_QUEUE_MAX_BYTES (4UL * 1024UL * 1024UL)
+#endif
+
+#ifndef CRYO_QUEUE_COMPACT_BYTES
+#define CRYO_QUEUE_COMPACT_BYTES (64UL * 1024UL)
+#endif
+
+#define CRYO_QUEUE_RECORD_HEADER_LENGTH 6
+#define CRYO_QUEUE_MAX_FRAME_LENGTH 255
+
+/*
+    name:           cryo_queue_init()
+    description:    starts the SD card and finds the frames left in the queue
+    arguments:      none
+    returns:        1 if the queue is ready, 0 if the SD card couldn't be started
+*/
+uint8_t cryo_queue_init();
+
+/*
+    name:           cryo_queue_push(uint32_t packet_id, const uint8_t* frame, uint8_t length)
+    description:    adds a frame to the end of the queue
+    arguments:      packet_id
+                        - id of the (first) reading in the frame
+                    frame
+                        - pointer to the frame
+                    length
+                        - length of the frame
+    returns:        1 if the frame was stored, 0 otherwise
+*/
+uint8_t cryo_queue_push(uint32_t packet_id, const uint8_t* frame, uint8_t length);
+
+/*
+    name:           cryo_queue_peek(uint32_t* packet_id, uint8_t* frame, uint8_t* length)
+    description:    reads the oldest frame in the queue without removing it.
+                    Damaged records are removed and skipped.
+    arguments:      packet_id
+                        - set to the packet id stored with the frame
+                    frame
+                        - buffer for the frame
+                    length
+                        - size of the frame buffer, set to the frame length
+    returns:        1 if a frame was read, 0 if the queue is empty or the frame
+                    doesn't fit in the buffer
+*/
+uint8_t cryo_queue_peek(uint32_t* packet_id, uint8_t* frame, uint8_t* length);
+
+/*
+    name:           cryo_queue_pop()
+    description:    removes the oldest frame from the queue.  The new head is 
+                    saved to the SD card by cryo_queue_sync(), or straight away 
+                    if the queue is now empty.
+    arguments:      none
+    returns:        1 if a frame was removed, 0 if the queue is empty
+*/
+uint8_t cryo_queue_pop();
+
+/*
+    name:           cryo_queue_sync()
+    description:    saves the head of the queue to the index file if frames 
+                    have been removed since it was last saved.  Call once after
+                    a batch of cryo_queue_pop() calls.
+    arguments:      none
+    returns:        1 if the index is up to date, 0 if it couldn't be written
+*/
+uint8_t cryo_queue_sync();
+
+/*
+    name:           cryo_queue_count()
+    description:    returns the number of frames in the queue
+    arguments:      none
+    returns:        number of frames
+*/
+uint32_t cryo_queue_count();
+
+#endif
@@ -28,9 +28,113 @@ SOFTWARE.
 #include "cryo_power.h"
 #include "cryo_sleep.h"
 #include "cryo_radio.h"
+#include "cryo_queue.h"
 #include "RH_RF95.h"
 
-RH_RF95 rf95(
+// RH_RF95 with its interrupt handler exposed, so that the radio interrupt 
+// can also report the end of an asynchronous transmission and collect frames
+class RadioRF95 : public RH_RF95 {
+
+    public:
+        RadioRF95(uint8_t slave_select_pin, uint8_t interrupt_pin) : 
+            RH_RF95(slave_select_pin, interrupt_pin) {}
+        void handle_interrupt() { handleInterrupt(); }
+        // Set by handle_interrupt() on a valid RxDone, which also leaves RX mode
+        bool rx_buffer_valid() { return _rxBufValid; }
+        // Move the frame handle_interrupt() read from the FIFO out of 
+        // RadioHead's buffer, or drop it, freeing the buffer.  Unlike recv(),
+        // these don't re-enable interrupts, so they can be used in the ISR.
+        uint8_t rx_buffer_take(uint8_t* data, uint8_t size);
+        void rx_buffer_drop() { _bufLen = 0; _rxBufValid = false; }
+        // Random byte from the receiver's noise, for the boot nonce
+        uint8_t random_byte();
+
+        // Copy the radio's configuration so it can be restored after power-up
+        void save_configuration();
+        // Restore the saved configuration (if any) once the radio is out of 
+        // reset, returning false if it doesn't come out of reset
+        bool restore_configuration();
+
+    private:
+        // RegFrfMsb (0x06) to RegModemConfig3 (0x26), which holds the 
+        // frequency, power, FIFO and modem settings
+        uint8_t configuration[RH_RF95_REG_26_MODEM_CONFIG3 - RH_RF95_REG_06_FRF_MSB + 1];
+        uint8_t dio_mapping;
+        uint8_t pa_dac;
+        uint8_t version;
+        bool configuration_saved = false;
+
+};
+
+void RadioRF95::save_configuration() {
+
+    spiBurstRead(RH_RF95_REG_06_FRF_MSB, configuration, sizeof(configuration));
+    dio_mapping = spiRead(RH_RF95_REG_40_DIO_MAPPING1);
+    pa_dac = spiRead(RH_RF95_REG_4D_PA_DAC);
+    version = spiRead(RH_RF95_REG_42_VERSION);
+    configuration_saved = true;
+
+}
+
+uint8_t RadioRF95::rx_buffer_take(uint8_t* data, uint8_t size) {
+
+    // RadioHead's buffer starts with the four header bytes
+    uint8_t length = _bufLen - RH_RF95_HEADER_LEN;
+    if (length > size)
+        length = size;
+    memcpy(data, _buf + RH_RF95_HEADER_LEN, length);
+    rx_buffer_drop();
+    return length;
+
+}
+
+uint8_t RadioRF95::random_byte() {
+
+    // The lowest bit of the wideband RSSI follows the receiver's noise
+    setModeRx();
+    uint8_t value = 0;
+    for (uint8_t k = 0; k < 8; k++) {
+        delay(1);
+        value = (value << 1) | (spiRead(RH_RF95_REG_2C_RSSI_WIDEBAND) & 1);
+    }
+    setModeIdle();
+    return value;
+
+}
+
+bool RadioRF95::restore_configuration() {
+
+    if (!configuration_saved)
+        return true;
+
+    // The radio answers SPI once it is out of power-on reset
+    uint32_t start = micros();
+    while (spiRead(RH_RF95_REG_42_VERSION) != version) {
+        if (micros() - start > CRYO_RADIO_RESUME_TIMEOUT_US)
+            return false;
+    }
+
+    // LoRa mode can only be selected in sleep mode, and takes effect after a
+    // short wait (RadioHead's init() allows 10 ms), so check it has before 
+    // writing the LoRa registers.  Read-only registers in the block ignore 
+    // the write, and RegIrqFlags is cleared by it.
+    spiWrite(RH_RF95_REG_01_OP_MODE, RH_RF95_MODE_SLEEP | RH_RF95_LONG_RANGE_MODE);
+    delay(10);
+    if (spiRead(RH_RF95_REG_01_OP_MODE) != (RH_RF95_MODE_SLEEP | RH_RF95_LONG_RANGE_MODE))
+        return false;
+    spiBurstWrite(RH_RF95_REG_06_FRF_MSB, configuration, sizeof(configuration));
+    spiWrite(RH_RF95_REG_40_DIO_MAPPING1, dio_mapping);
+    spiWrite(RH_RF95_REG_4D_PA_DAC, pa_dac);
+
+    // Standby, and let RadioHead know, as it skips the write if it thinks
+    // the radio is already idle
+    spiWrite(RH_RF95_REG_01_OP_MODE, RH_RF95_MODE_STDBY | RH_RF95_LONG_RANGE_MODE);
+    setModeIdle();
+    return true;
+
+}
+
+RadioRF95 rf95(
     CRYO_PIN_RADIO_CS,
     CRYO_PIN_RADIO_IRQ
 );
@@ -39,6 +143,187 @@ RH_RF95 rf95(
 cryo_radio_packet radio_packet; 
 PseudoRTC* radio_rtc;
 
+// Oldest housekeeping snapshot (cryo_power_get_snapshot()) to send, in seconds
+uint32_t radio_housekeeping_max_age = 0;
+
+// Readings waiting to be sent as a batch frame
+cryo_radio_packet_v2 radio_batch[CRYO_RADIO_BATCH_MAX_READINGS];
+uint8_t radio_batch_count = 0;
+uint8_t radio_batch_max_readings = UINT8_MAX;
+uint32_t radio_batch_max_age = 0;
+
+// Compressed batches are encoded into the frame as readings are added, with 
+// the first reading kept in radio_batch[0] for the header and age
+bool radio_batch_compress = false;
+uint8_t radio_batch_frame[CRYO_RADIO_MAX_MESSAGE_LENGTH];
+uint16_t radio_batch_frame_length = 0;
+cryo_codec_delta radio_batch_codec;
+
+// Fields of a reading that are delta encoded, from epoch onwards
+#define RADIO_READING_FIELDS 10
+
+// Frames that couldn't be sent are kept in the SD card queue (cryo_queue)
+bool radio_queue_enabled = false;
+uint8_t radio_queue_frames_per_send = 0;
+uint32_t radio_queue_interval_ms = 0;
+
+// Frames are numbered as they are first transmitted (the RadioHead header 
+// ID), with a nonce chosen at start-up (the header FROM) marking restarts
+uint8_t radio_boot_nonce = 0;
+uint8_t radio_frame_sequence = 0;
+
+// Reliable mode - frames are kept until the gateway acknowledges them
+typedef struct radio_history_entry {
+    uint32_t packet_id;
+    uint8_t sequence;
+    uint8_t length;
+    uint8_t retries;
+    uint8_t data[CRYO_RADIO_MAX_MESSAGE_LENGTH];
+} radio_history_entry;
+
+// Every frame in the history must fit in the gateway's 32 frame window
+static_assert(CRYO_RADIO_RELIABLE_HISTORY < 32, "CRYO_RADIO_RELIABLE_HISTORY is too large for the acknowledgement bitmap");
+
+bool radio_reliable = false;
+uint16_t radio_ack_window_ms = 0;
+uint8_t radio_max_retries = 0;
+radio_history_entry radio_history[CRYO_RADIO_RELIABLE_HISTORY];
+uint8_t radio_history_count = 0;
+cryo_radio_ack radio_last_ack;
+bool radio_last_ack_valid = false;
+
+// Time-division slots - each logger only transmits in its own slot of the frame
+bool radio_tdma_enabled = false;
+uint32_t radio_tdma_frame_seconds = 0;
+uint32_t radio_tdma_slot_start = 0;
+uint32_t radio_tdma_slot_end = 0;
+uint8_t radio_tdma_alarm = 0xff;
+void (*radio_tdma_callback)() = NULL;
+cryo_radio_tdma_stats radio_tdma_stats;
+// Frames sent outside the slot without the queue, sent when the slot starts
+radio_history_entry radio_tdma_held[CRYO_RADIO_TDMA_HELD];
+uint8_t radio_tdma_held_count = 0;
+
+// LoRa data rates from the most robust to the fastest, all 125 kHz bandwidth, 
+// coding rate 4/5, explicit header and CRC (RegModemConfig1, 2 and 3)
+const RH_RF95::ModemConfig radio_data_rates[CRYO_RADIO_DATA_RATES] = {
+    {0x72, 0xc4, 0x0c},     // SF12, low data rate optimisation
+    {0x72, 0xb4, 0x0c},     // SF11, low data rate optimisation
+    {0x72, 0xa4, 0x04},     // SF10
+    {0x72, 0x94, 0x04},     // SF9
+    {0x72, 0x84, 0x04},     // SF8
+    {0x72, 0x74, 0x04}      // SF7 (RadioHead's default, Bw125Cr45Sf128)
+};
+// SNR needed to demodulate each data rate in dB
+const int8_t radio_data_rate_snr[CRYO_RADIO_DATA_RATES] = {-20, -18, -15, -13, -10, -8};
+
+// Link settings, programmed (and saved with the rest of the configuration) 
+// the next time the radio is switched on after they change
+bool radio_link_changed = false;
+
+// Power state, and the time the last power-up took to be ready to transmit
+bool radio_powered = false;
+uint32_t radio_resume_micros = 0;
+uint8_t radio_data_rate = CRYO_RADIO_DATA_RATES - 1;
+int8_t radio_tx_power = CRYO_RADIO_TX_POWER_MAX;
+
+// Adaptive data rate - the best SNR reported by the gateway since the last change
+bool radio_adr_enabled = false;
+bool radio_adr_data_rate = false;
+int8_t radio_adr_best_snr = 0;
+uint8_t radio_adr_count = 0;
+uint8_t radio_adr_losses = 0;
+
+// Receive engine (gateway) - frames are moved out of the radio by the RxDone 
+// interrupt into a ring of buffers, which the main loop reads in place
+bool radio_rx_enabled = false;
+cryo_radio_rx_frame radio_rx_pool[CRYO_RADIO_RX_POOL_SIZE];
+// head is only written by the interrupt and tail by the main loop
+volatile uint8_t radio_rx_head = 0;
+volatile uint8_t radio_rx_tail = 0;
+volatile uint8_t radio_rx_count = 0;
+volatile uint32_t radio_rx_received = 0;
+volatile uint32_t radio_rx_overflows = 0;
+
+// Asynchronous transmission in progress, cleared by the radio interrupt
+volatile bool radio_async_busy = false;
+// Set by the radio interrupt when a transmission has ended but the radio is
+// still powered and the EIC still on the standby clock
+volatile bool radio_async_pending = false;
+// RadioHead's TxDone count when the transmission started
+volatile uint16_t radio_async_tx_good = 0;
+// EIC generic clock selection (CLKCTRL) before the transmission started
+uint16_t radio_async_eic_clock = 0;
+void (*radio_async_callback)(uint8_t sent) = NULL;
+
+// End an asynchronous transmission - safe to call from the radio interrupt,
+// leaving the radio and clock for radio_async_finish()
+void radio_async_complete(uint8_t sent) {
+
+    radio_async_busy = false;
+    radio_async_pending = true;
+    if (radio_async_callback != NULL)
+        radio_async_callback(sent);
+
+}
+
+// Power down the radio and return the EIC to its own clock once an 
+// asynchronous transmission has ended
+void radio_async_finish() {
+
+    noInterrupts();
+    bool pending = radio_async_pending;
+    radio_async_pending = false;
+    interrupts();
+
+    if (pending) {
+        cryo_radio_disable();
+        GCLK->CLKCTRL.reg = radio_async_eic_clock;
+        while (GCLK->STATUS.bit.SYNCBUSY);
+    }
+
+}
+
+// Move a received frame into the next free buffer in the ring, then listen 
+// for the next one.  Called from the radio interrupt, so the frame is copied
+// straight from RadioHead's buffer rather than with recv().
+void radio_rx_store() {
+
+    if (radio_rx_count == CRYO_RADIO_RX_POOL_SIZE) {
+        // No room - drop the frame to free the radio's buffer
+        rf95.rx_buffer_drop();
+        radio_rx_overflows++;
+    } else {
+        cryo_radio_rx_frame* frame = &radio_rx_pool[radio_rx_head];
+        frame->timestamp = millis();
+        frame->rssi = rf95.lastRssi();
+        frame->snr = rf95.lastSNR();
+        frame->boot = rf95.headerFrom();
+        frame->sequence = rf95.headerId();
+        frame->length = rf95.rx_buffer_take(frame->data, sizeof(frame->data));
+
+        radio_rx_head = (radio_rx_head + 1) % CRYO_RADIO_RX_POOL_SIZE;
+        radio_rx_count++;
+        radio_rx_received++;
+    }
+    // RadioHead leaves the radio idle after RxDone
+    rf95.setModeRx();
+
+}
+
+// Radio DIO0 interrupt - RadioHead handles the radio's IRQ flags, counting
+// TxDone in txGood(), so other interrupts (CadDone, or a stale one before
+// the transmission starts) don't complete an asynchronous transmission
+void radio_isr() {
+
+    rf95.handle_interrupt();
+    if (radio_async_busy && rf95.txGood() != radio_async_tx_good)
+        radio_async_complete(1);
+    if (radio_rx_enabled && rf95.rx_buffer_valid())
+        radio_rx_store();
+
+}
+
 uint8_t cryo_radio_init(uint32_t sensor_id, PseudoRTC* rtc) {
     
     // Attempt to start the RF95 radio module
@@ -58,6 +343,17 @@ uint8_t cryo_radio_init(uint32_t sensor_id, PseudoRTC* rtc) {
     // you can set transmitter powers from 5 to 23 dBm:
     rf95.setTxPower(23, false);
 
+    // Keep the configuration to restore each time the radio is switched on
+    rf95.save_configuration();
+
+    // Let the gateway tell this run's frames from those sent before a reset
+    radio_boot_nonce = rf95.random_byte();
+    rf95.setHeaderFrom(radio_boot_nonce);
+
+    // Replace RadioHead's interrupt handler with one that also completes 
+    // asynchronous transmissions
+    attachInterrupt(digitalPinToInterrupt(CRYO_PIN_RADIO_IRQ), radio_isr, RISING);
+
     // Assign the radio_rtc pointer so we can access timestamps
     radio_rtc = rtc;
 
@@ -84,18 +380,644 @@ uint8_t cryo_radio_init(uint32_t sensor_id, PseudoRTC* rtc) {
 
 void cryo_radio_enable() {
 
+    if (radio_powered)
+        return;
+
+    uint32_t start = micros();
     digitalWrite(CRYO_PIN_RADIO_ENABLE, HIGH);
+    radio_powered = true;
+
+    // Switching off loses the configuration, so write it back
+    if (!rf95.restore_configuration())
+        CRYO_DEBUG_MESSAGE("Failed to restore radio configuration.");
+    if (radio_link_changed) {
+        rf95.setModemRegisters(&radio_data_rates[radio_data_rate]);
+        rf95.setTxPower(radio_tx_power, false);
+        rf95.save_configuration();
+        radio_link_changed = false;
+    }
+    radio_resume_micros = micros() - start;
 
 }
 
 void cryo_radio_disable() {
 
     digitalWrite(CRYO_PIN_RADIO_ENABLE, LOW);
+    radio_powered = false;
 
 }
 
 int16_t packetnum = 0; 
 
+void radio_adr_apply(uint8_t data_rate, int8_t tx_power) {
+
+    if (data_rate != radio_data_rate || tx_power != radio_tx_power)
+        cryo_radio_set_link(data_rate, tx_power);
+    radio_adr_count = 0;
+
+}
+
+// Adjust the link from the SNR of a frame at the gateway, once there are
+// enough acknowledgements to go on.  Each 3 dB of margin above the SNR the
+// data rate needs (plus CRYO_RADIO_ADR_MARGIN_DB) allows one step faster or
+// 3 dB less power, and each 3 dB short needs 3 dB more power (then a step
+// slower once at full power).
+void radio_adr_update(int8_t snr) {
+
+    radio_adr_losses = 0;
+    if (!radio_adr_enabled)
+        return;
+
+    if (radio_adr_count == 0 || snr > radio_adr_best_snr)
+        radio_adr_best_snr = snr;
+    if (++radio_adr_count < CRYO_RADIO_ADR_HISTORY)
+        return;
+
+    int16_t margin = radio_adr_best_snr - radio_data_rate_snr[radio_data_rate] - CRYO_RADIO_ADR_MARGIN_DB;
+    // Round towards minus infinity, so a small shortfall still adds power
+    int16_t steps = margin >= 0 ? margin / 3 : -((2 - margin) / 3);
+
+    uint8_t data_rate = radio_data_rate;
+    int8_t tx_power = radio_tx_power;
+    while (steps > 0 && radio_adr_data_rate && data_rate < CRYO_RADIO_DATA_RATES - 1) {
+        data_rate++;
+        steps--;
+    }
+    while (steps > 0 && tx_power > CRYO_RADIO_TX_POWER_MIN) {
+        tx_power -= 3;
+        steps--;
+    }
+    while (steps < 0 && tx_power < CRYO_RADIO_TX_POWER_MAX) {
+        tx_power += 3;
+        steps++;
+    }
+    while (steps < 0 && radio_adr_data_rate && data_rate > 0) {
+        data_rate--;
+        steps++;
+    }
+    radio_adr_apply(data_rate, tx_power);
+
+}
+
+// After several frames in a row without an acknowledgement, fall back to 
+// full power, then to slower data rates
+void radio_adr_loss() {
+
+    if (!radio_adr_enabled || ++radio_adr_losses < CRYO_RADIO_ADR_LOSS_LIMIT)
+        return;
+
+    radio_adr_losses = 0;
+    if (radio_tx_power < CRYO_RADIO_TX_POWER_MAX)
+        radio_adr_apply(radio_data_rate, CRYO_RADIO_TX_POWER_MAX);
+    else if (radio_adr_data_rate && radio_data_rate > 0)
+        radio_adr_apply(radio_data_rate - 1, radio_tx_power);
+    else
+        radio_adr_count = 0;
+
+}
+
+// Switch on the radio, send a frame with its sequence number and wait for it 
+// to complete, then switch the radio off unless it is needed to receive.  
+// Returns 1 if the frame was sent.
+int32_t radio_transmit(const uint8_t* data, uint8_t length, uint8_t sequence, bool power_down = true) {
+
+    // Let an asynchronous transmission finish before using the radio
+    cryo_radio_async_wait(250);
+
+    CRYO_DEBUG_MESSAGE("enabling radio module");
+    Serial1.flush();
+    // Turn on radio modulke
+    cryo_radio_enable();
+
+    // Serial1.print("cryo_radio_packet is bytes long: ");
+    // CRYO_DEBUG_MESSAGE(sizeof(radio_packet));
+    Serial1.flush();
+
+    if (radio_tdma_enabled && rf95.isChannelActive()) {
+        // Another logger is transmitting in this slot - back off by an 
+        // amount that differs between loggers before sending anyway
+        radio_tdma_stats.collisions++;
+        delay(10 + radio_packet.sensor_id % 64);
+    }
+
+    int32_t sent = 0;
+    CRYO_DEBUG_MESSAGE("Sending packet..."); delay(10) ;
+    rf95.setHeaderId(sequence);
+    rf95.send(data, length);
+    CRYO_DEBUG_MESSAGE("Waiting for packet to complete..."); delay(10);
+    if (rf95.waitPacketSent(250)) {
+        CRYO_DEBUG_MESSAGE("Radio packet sent");
+        sent = 1;
+    } else {
+        CRYO_DEBUG_MESSAGE("Failed to send radio packet.");
+    };
+
+    if (power_down) {
+        cryo_radio_disable();
+        CRYO_DEBUG_MESSAGE("Disabling radio");
+    }
+
+    return sent;
+
+}
+
+// Keep a frame that wasn't delivered in the SD card queue, if enabled
+uint8_t radio_queue_frame(const uint8_t* data, uint8_t length, uint32_t packet_id) {
+
+    if (!radio_queue_enabled)
+        return 0;
+    if (!cryo_queue_push(packet_id, data, length)) {
+        CRYO_DEBUG_MESSAGE("Failed to queue radio packet.");
+        return 0;
+    }
+    return 1;
+
+}
+
+void radio_history_remove(uint8_t index) {
+
+    radio_history_count--;
+    for (uint8_t k = index; k < radio_history_count; k++)
+        radio_history[k] = radio_history[k + 1];
+
+}
+
+// Keep a frame until it is acknowledged.  With the queue enabled nothing is
+// sent while the history is full; without it the oldest frame is dropped.
+void radio_history_add(const uint8_t* data, uint8_t length, uint32_t packet_id, uint8_t sequence) {
+
+    if (radio_history_count == CRYO_RADIO_RELIABLE_HISTORY)
+        radio_history_remove(0);
+    radio_history_entry* entry = &radio_history[radio_history_count++];
+    entry->packet_id = packet_id;
+    entry->sequence = sequence;
+    entry->length = length;
+    entry->retries = 0;
+    memcpy(entry->data, data, length);
+
+}
+
+// Listen for an acknowledgement addressed to this sensor
+uint8_t radio_receive_ack(cryo_radio_ack* ack) {
+
+    uint32_t start = millis();
+    uint32_t elapsed = 0;
+    while (elapsed < radio_ack_window_ms) {
+        if (!rf95.waitAvailableTimeout(radio_ack_window_ms - elapsed))
+            return 0;
+        uint8_t buffer[CRYO_RADIO_MAX_MESSAGE_LENGTH];
+        uint8_t length = sizeof(buffer);
+        if (
+            rf95.recv(buffer, &length) && 
+            cryo_radio_decode_ack(buffer, length, ack) && 
+            ack->sensor_id == radio_packet.sensor_id &&
+            ack->boot == radio_boot_nonce
+        ) {
+            return 1;
+        }
+        elapsed = millis() - start;
+    }
+    return 0;
+
+}
+
+// After transmitting, listen for the gateway's acknowledgement and resend 
+// only the frames it hasn't received, then switch the radio off.  Frames 
+// are kept for the next exchange if no acknowledgement arrives.
+void radio_ack_exchange() {
+
+    while (radio_history_count > 0) {
+        cryo_radio_ack ack;
+        if (!radio_receive_ack(&ack)) {
+            radio_tdma_stats.ack_timeouts++;
+            radio_adr_loss();
+            break;
+        }
+        radio_last_ack = ack;
+        radio_last_ack_valid = true;
+        radio_adr_update(ack.snr);
+
+        uint8_t resent = 0;
+        uint8_t k = 0;
+        while (k < radio_history_count) {
+            radio_history_entry* entry = &radio_history[k];
+            if (cryo_radio_ack_contains(&ack, entry->sequence)) {
+                radio_history_remove(k);
+                continue;
+            }
+            if (entry->retries >= radio_max_retries) {
+                // Give up on the radio link for this frame
+                radio_queue_frame(entry->data, entry->length, entry->packet_id);
+                radio_history_remove(k);
+                continue;
+            }
+            entry->retries++;
+            if (radio_transmit(entry->data, entry->length, entry->sequence, false))
+                resent++;
+            k++;
+        }
+        if (resent == 0)
+            break;
+    }
+    cryo_radio_disable();
+
+}
+
+uint16_t radio_queue_drain(uint16_t max_frames) {
+
+    uint8_t frame[CRYO_QUEUE_MAX_FRAME_LENGTH];
+    uint16_t sent = 0;
+    while (sent < max_frames) {
+        uint32_t packet_id;
+        uint8_t length = sizeof(frame);
+        // Frames sent now would overtake those waiting for an acknowledgement
+        if (radio_reliable && radio_history_count == CRYO_RADIO_RELIABLE_HISTORY)
+            break;
+        if (!cryo_queue_peek(&packet_id, frame, &length))
+            break;
+        // Spent awake - the alarms behind cryo_sleep() count whole seconds
+        if (sent > 0 && radio_queue_interval_ms > 0)
+            delay(radio_queue_interval_ms);
+        // Stop at the first failure, keeping the frame for next time
+        uint8_t sequence = radio_frame_sequence++;
+        if (!radio_transmit(frame, length, sequence, !radio_reliable))
+            break;
+        cryo_queue_pop();
+        if (radio_reliable)
+            radio_history_add(frame, length, packet_id, sequence);
+        sent++;
+    }
+    // One index write for the whole batch
+    cryo_queue_sync();
+    return sent;
+
+}
+
+// Keep a frame in RAM until the slot starts, dropping the oldest if full
+void radio_tdma_hold(const uint8_t* data, uint8_t length, uint32_t packet_id) {
+
+    if (radio_tdma_held_count == CRYO_RADIO_TDMA_HELD) {
+        radio_tdma_held_count--;
+        for (uint8_t k = 0; k < radio_tdma_held_count; k++)
+            radio_tdma_held[k] = radio_tdma_held[k + 1];
+    }
+    radio_history_entry* entry = &radio_tdma_held[radio_tdma_held_count++];
+    entry->packet_id = packet_id;
+    entry->length = length;
+    entry->retries = 0;
+    // data may be a held frame that is being held again
+    memmove(entry->data, data, length);
+
+}
+
+// Transmit a frame, queueing it if it couldn't be sent.  Frames leave in 
+// packet_id order, so while older frames are queued (or the reliable history
+// is full) the frame joins the end of the queue and the oldest are sent.
+int32_t radio_send_frame(const uint8_t* data, uint8_t length, uint32_t packet_id) {
+
+    if (radio_tdma_enabled) {
+        if (!cryo_radio_tdma_in_slot()) {
+            radio_tdma_stats.slot_misses++;
+            // Hold the frame until the slot starts rather than risk a 
+            // collision - in the SD card queue if enabled, otherwise in RAM
+            if (!radio_queue_frame(data, length, packet_id))
+                radio_tdma_hold(data, length, packet_id);
+            return 0;
+        }
+        radio_tdma_stats.frames_in_slot++;
+    }
+
+    int32_t sent = 0;
+    bool transmitted = false;
+    bool backlog = radio_queue_enabled && (
+        cryo_queue_count() > 0 || 
+        (radio_reliable && radio_history_count == CRYO_RADIO_RELIABLE_HISTORY)
+    );
+    if (backlog && radio_queue_frame(data, length, packet_id)) {
+        transmitted = radio_queue_drain(radio_queue_frames_per_send) > 0;
+        sent = cryo_queue_count() == 0;
+        if (!transmitted && radio_reliable && radio_history_count > 0) {
+            // Resend the oldest unacknowledged frame to prompt an 
+            // acknowledgement, so that the history can clear
+            radio_history_entry* entry = &radio_history[0];
+            entry->retries++;
+            transmitted = radio_transmit(entry->data, entry->length, entry->sequence, false);
+        }
+    } else {
+        uint8_t sequence = radio_frame_sequence++;
+        sent = radio_transmit(data, length, sequence, !radio_reliable);
+        transmitted = sent;
+        if (!sent)
+            radio_queue_frame(data, length, packet_id);
+        else if (radio_reliable)
+            radio_history_add(data, length, packet_id, sequence);
+    }
+    if (radio_reliable) {
+        if (transmitted)
+            radio_ack_exchange();
+        else
+            cryo_radio_disable();
+    }
+    return sent;
+
+}
+
+uint8_t cryo_radio_queue_configure(bool enable, uint8_t frames_per_send, uint32_t interval_ms) {
+
+    radio_queue_frames_per_send = frames_per_send;
+    radio_queue_interval_ms = interval_ms;
+    radio_queue_enabled = enable && cryo_queue_init();
+    return enable == radio_queue_enabled;
+
+}
+
+uint16_t cryo_radio_queue_drain(uint16_t max_frames) {
+
+    uint16_t sent = radio_queue_drain(max_frames);
+    if (radio_reliable) {
+        if (sent > 0)
+            radio_ack_exchange();
+        else
+            cryo_radio_disable();
+    }
+    return sent;
+
+}
+
+// Send the frames held since the last slot, in order
+void radio_tdma_send_held() {
+
+    // Frames held again (if the slot has already passed) are moved to the 
+    // front, which has already been read
+    uint8_t count = radio_tdma_held_count;
+    radio_tdma_held_count = 0;
+    for (uint8_t k = 0; k < count; k++)
+        radio_send_frame(radio_tdma_held[k].data, radio_tdma_held[k].length, radio_tdma_held[k].packet_id);
+
+}
+
+// Slot alarm - send what has been held for the slot, then raise the caller's
+// alarm, or send some of the queue if there is none
+void radio_tdma_slot_alarm() {
+
+    radio_tdma_send_held();
+    if (radio_tdma_callback != NULL)
+        radio_tdma_callback();
+    else if (radio_queue_enabled && radio_queue_frames_per_send > 0 && cryo_queue_count() > 0)
+        cryo_radio_queue_drain(radio_queue_frames_per_send);
+
+}
+
+uint16_t cryo_radio_tdma_configure(uint32_t frame_seconds, uint16_t slots, void (*callback)()) {
+
+    // Held frames are kept for the new slot
+    if (radio_tdma_alarm != 0xff)
+        radio_rtc->remove_alarm(radio_tdma_alarm);
+    radio_tdma_alarm = 0xff;
+    radio_tdma_enabled = false;
+    if (slots == 0 || frame_seconds == 0) {
+        radio_tdma_send_held();
+        return 0;
+    }
+
+    // Slots are whole seconds, as kept by the PseudoRTC
+    if (slots > frame_seconds)
+        slots = frame_seconds;
+    uint16_t slot = radio_packet.sensor_id % slots;
+    radio_tdma_frame_seconds = frame_seconds;
+    radio_tdma_slot_start = slot * frame_seconds / slots;
+    radio_tdma_slot_end = (slot + 1) * frame_seconds / slots;
+    radio_tdma_enabled = true;
+
+    radio_tdma_callback = callback;
+    radio_tdma_alarm = radio_rtc->add_alarm_aligned(frame_seconds, radio_tdma_slot_start, radio_tdma_slot_alarm);
+    return slot;
+
+}
+
+void cryo_radio_tdma_disable() {
+
+    if (radio_tdma_alarm != 0xff)
+        radio_rtc->remove_alarm(radio_tdma_alarm);
+    radio_tdma_alarm = 0xff;
+    radio_tdma_enabled = false;
+
+    // Nothing to wait for now
+    radio_tdma_send_held();
+
+}
+
+uint8_t cryo_radio_tdma_in_slot() {
+
+    if (!radio_tdma_enabled)
+        return 1;
+    uint32_t position = radio_rtc->get_epoch() % radio_tdma_frame_seconds;
+    return position >= radio_tdma_slot_start && position < radio_tdma_slot_end;
+
+}
+
+void cryo_radio_tdma_get_stats(cryo_radio_tdma_stats* stats) {
+
+    *stats = radio_tdma_stats;
+
+}
+
+void cryo_radio_set_housekeeping_max_age(uint32_t max_age) {
+
+    radio_housekeeping_max_age = max_age;
+
+}
+
+uint32_t cryo_radio_get_resume_micros() {
+
+    return radio_resume_micros;
+
+}
+
+void cryo_radio_set_link(uint8_t data_rate, int8_t tx_power) {
+
+    if (data_rate >= CRYO_RADIO_DATA_RATES)
+        data_rate = CRYO_RADIO_DATA_RATES - 1;
+    if (tx_power < CRYO_RADIO_TX_POWER_MIN)
+        tx_power = CRYO_RADIO_TX_POWER_MIN;
+    if (tx_power > CRYO_RADIO_TX_POWER_MAX)
+        tx_power = CRYO_RADIO_TX_POWER_MAX;
+
+    radio_data_rate = data_rate;
+    radio_tx_power = tx_power;
+    radio_link_changed = true;
+
+}
+
+uint8_t cryo_radio_get_data_rate() {
+
+    return radio_data_rate;
+
+}
+
+int8_t cryo_radio_get_tx_power() {
+
+    return radio_tx_power;
+
+}
+
+void cryo_radio_adr_configure(bool enable, bool adapt_data_rate) {
+
+    radio_adr_enabled = enable;
+    radio_adr_data_rate = adapt_data_rate;
+    radio_adr_count = 0;
+    radio_adr_losses = 0;
+
+}
+
+void cryo_radio_reliable_configure(bool enable, uint16_t window_ms, uint8_t max_retries) {
+
+    if (!enable) {
+        // Frames still waiting for an acknowledgement go to the queue
+        for (uint8_t k = 0; k < radio_history_count; k++)
+            radio_queue_frame(radio_history[k].data, radio_history[k].length, radio_history[k].packet_id);
+        radio_history_count = 0;
+    }
+    radio_reliable = enable;
+    radio_ack_window_ms = window_ms;
+    radio_max_retries = max_retries;
+
+}
+
+uint8_t cryo_radio_reliable_pending() {
+
+    return radio_history_count;
+
+}
+
+uint8_t cryo_radio_get_last_ack(cryo_radio_ack* ack) {
+
+    if (!radio_last_ack_valid)
+        return 0;
+    *ack = radio_last_ack;
+    return 1;
+
+}
+
+uint8_t cryo_radio_ack_contains(const cryo_radio_ack* ack, uint8_t sequence) {
+
+    uint8_t behind = ack->sequence - sequence;
+    return behind < 32 && (ack->bitmap >> behind) & 1;
+
+}
+
+void cryo_radio_ack_tracker_init(cryo_radio_ack* tracker, uint32_t sensor_id) {
+
+    tracker->sensor_id = sensor_id;
+    tracker->boot = 0;
+    tracker->sequence = 0;
+    tracker->bitmap = 0;
+    tracker->rssi = 0;
+    tracker->snr = 0;
+
+}
+
+uint8_t cryo_radio_ack_tracker_record(cryo_radio_ack* tracker, uint8_t boot, uint8_t sequence) {
+
+    int8_t ahead = (int8_t) (sequence - tracker->sequence);
+    bool restarted = tracker->bitmap == 0 || boot != tracker->boot;
+    if (restarted || ahead > 0 || ahead <= -32) {
+        // Newest frame so far - slide the window up to it.  The window starts
+        // again when the sensor restarts, or if the gateway has missed so many
+        // frames that the sequence number has wrapped past it, as resends are
+        // always within the window.
+        if (!restarted && ahead > 0 && ahead < 32)
+            tracker->bitmap = (tracker->bitmap << ahead) | 1;
+        else
+            tracker->bitmap = 1;
+        tracker->boot = boot;
+        tracker->sequence = sequence;
+        return 1;
+    }
+    uint32_t mask = (uint32_t) 1 << -ahead;
+    uint8_t is_new = !(tracker->bitmap & mask);
+    tracker->bitmap |= mask;
+    return is_new;
+
+}
+
+void cryo_radio_set_async_callback(void (*callback)(uint8_t sent)) {
+
+    radio_async_callback = callback;
+
+}
+
+int32_t cryo_radio_send_async(const uint8_t* data, uint8_t length) {
+
+    if (radio_async_busy)
+        return 0;
+
+    // The EIC needs a clock to detect TxDone while the processor sleeps.  If
+    // the last transmission hasn't been tidied up it is still attached (and
+    // the radio on), so keep the selection saved then
+    noInterrupts();
+    bool pending = radio_async_pending;
+    radio_async_pending = false;
+    interrupts();
+    if (!pending) {
+        *((volatile uint8_t*) &GCLK->CLKCTRL.reg) = GCLK_CLKCTRL_ID_EIC;
+        radio_async_eic_clock = GCLK->CLKCTRL.reg;
+        cryo_standby_clock_attach(GCLK_CLKCTRL_ID_EIC);
+    }
+    cryo_radio_enable();
+
+    // Set before sending, as TxDone can arrive before send() returns
+    radio_async_tx_good = rf95.txGood();
+    radio_async_busy = true;
+    rf95.setHeaderId(radio_frame_sequence++);
+    if (!rf95.send(data, length)) {
+        radio_async_complete(0);
+        radio_async_finish();
+        return 0;
+    }
+    return length;
+
+}
+
+bool cryo_radio_async_busy() {
+
+    if (radio_async_busy)
+        return true;
+    radio_async_finish();
+    return false;
+
+}
+
+uint8_t cryo_radio_async_wait(uint32_t timeout_ms) {
+
+    uint32_t start = millis();
+    while (radio_async_busy) {
+        if (millis() - start >= timeout_ms) {
+            cryo_radio_async_cancel();
+            return 0;
+        }
+    }
+    radio_async_finish();
+    return 1;
+
+}
+
+void cryo_radio_async_cancel() {
+
+    // Claim the transmission so the interrupt can't complete it as well
+    noInterrupts();
+    bool busy = radio_async_busy;
+    radio_async_busy = false;
+    interrupts();
+
+    if (busy) {
+        rf95.setModeIdle();
+        radio_async_complete(0);
+    }
+    radio_async_finish();
+
+}
+
 int32_t cryo_radio_send_packet(float_t ds18b20_temp, float_t pt1000_temp)
 {
     // Send packet with a fake raw value
@@ -118,47 +1040,557 @@ int32_t cryo_radio_send_packet(
     // Now assign housekeeping values
     CRYO_DEBUG_MESSAGE("Assigning housekeeping data to packet");
     Serial1.flush();
-    radio_packet.battery_voltage = cryo_power_battery_voltage();
-    radio_packet.battery_current = cryo_power_battery_current();
-    radio_packet.solar_panel_voltage = cryo_power_solar_panel_voltage();
-    radio_packet.solar_panel_current = cryo_power_solar_panel_current();
-    radio_packet.load_voltage = cryo_power_load_voltage();
-    radio_packet.load_current = cryo_power_load_current();
+    cryo_power_snapshot housekeeping;
+    cryo_power_get_snapshot(&housekeeping, radio_housekeeping_max_age);
+    radio_packet.battery_voltage = housekeeping.battery_voltage;
+    radio_packet.battery_current = housekeeping.battery_current;
+    radio_packet.solar_panel_voltage = housekeeping.solar_panel_voltage;
+    radio_packet.solar_panel_current = housekeeping.solar_panel_current;
+    radio_packet.load_voltage = housekeeping.load_voltage;
+    radio_packet.load_current = housekeeping.load_current;
 
     CRYO_DEBUG_MESSAGE("Assigning timestamp to packet");
     Serial1.flush();
     // copy timestamp
     radio_rtc->get_timestamp(radio_packet.timestamp);
 
-    CRYO_DEBUG_MESSAGE("enabling radio module");
-    Serial1.flush();
-    // Turn on radio modulke
-    cryo_radio_enable();
-
-    // Serial1.print("cryo_radio_packet is bytes long: ");
-    // CRYO_DEBUG_MESSAGE(sizeof(radio_packet));
-    Serial1.flush();
-
-    CRYO_DEBUG_MESSAGE("Sending packet..."); delay(10) ;
-    rf95.send((uint8_t *) &radio_packet, sizeof(radio_packet));
-    CRYO_DEBUG_MESSAGE("Waiting for packet to complete..."); delay(10);
-    if (rf95.waitPacketSent(250)) {
-        CRYO_DEBUG_MESSAGE("Radio packet sent");
-    } else {
-        CRYO_DEBUG_MESSAGE("Failed to send radio packet.");
-    };
+    radio_send_frame((uint8_t *) &radio_packet, sizeof(radio_packet), radio_packet.packet_id);
 
     // Increment the sequence id
     radio_packet.packet_id++;
-
-    cryo_radio_disable();
-    CRYO_DEBUG_MESSAGE("Disabling radio");
     
     // // Do something with the packet
     return sizeof(radio_packet);
 
 }
 
+// Scale a float to a fixed-point integer, rounding and saturating to [min, max]
+int32_t radio_fixed_point(float_t value, float_t scale, int32_t min, int32_t max) {
+
+    float_t scaled = value * scale;
+    if (scaled >= (float_t) max)
+        return max;
+    if (scaled <= (float_t) min)
+        return min;
+    return (int32_t) (scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+
+}
+
+int32_t radio_saturate(int32_t value, int32_t min, int32_t max) {
+    return value > max ? max : (value < min ? min : value);
+}
+
+// Write the low width bits of value to buffer MSB first, starting at *bit
+void radio_pack_bits(uint8_t* buffer, uint16_t* bit, uint32_t value, uint8_t width) {
+
+    for (int8_t k = width - 1; k >= 0; k--) {
+        uint8_t mask = 0x80 >> (*bit & 7);
+        if ((value >> k) & 1)
+            buffer[*bit >> 3] |= mask;
+        else
+            buffer[*bit >> 3] &= ~mask;
+        (*bit)++;
+    }
+
+}
+
+// Read width bits MSB first from buffer, starting at *bit
+uint32_t radio_unpack_bits(const uint8_t* buffer, uint16_t* bit, uint8_t width) {
+
+    uint32_t value = 0;
+    for (uint8_t k = 0; k < width; k++) {
+        value = (value << 1) | ((buffer[*bit >> 3] >> (7 - (*bit & 7))) & 1);
+        (*bit)++;
+    }
+    return value;
+
+}
+
+// Read a signed (two's complement) field of width bits
+int32_t radio_unpack_signed(const uint8_t* buffer, uint16_t* bit, uint8_t width) {
+
+    uint32_t value = radio_unpack_bits(buffer, bit, width);
+    uint32_t sign = 1ul << (width - 1);
+    return (int32_t) ((value ^ sign) - sign);
+
+}
+
+// Pack the fields of a v2 packet from epoch onwards (the reading itself)
+void radio_pack_reading(uint8_t* buffer, uint16_t* position, const cryo_radio_packet_v2* packet) {
+
+    uint16_t bit = *position;
+    radio_pack_bits(buffer, &bit, packet->epoch, 32);
+    radio_pack_bits(buffer, &bit, (uint16_t) packet->ds18b20_temperature, 16);
+    radio_pack_bits(buffer, &bit, (uint32_t) radio_saturate(packet->pt1000_temperature, -524288, 524287), 20);
+    radio_pack_bits(buffer, &bit, (uint16_t) packet->raw_adc_value, 16);
+    radio_pack_bits(buffer, &bit, radio_saturate(packet->battery_voltage, 0, 0x7fff), 15);
+    radio_pack_bits(buffer, &bit, (uint16_t) packet->battery_current, 16);
+    radio_pack_bits(buffer, &bit, radio_saturate(packet->solar_panel_voltage, 0, 0x7fff), 15);
+    radio_pack_bits(buffer, &bit, (uint16_t) packet->solar_panel_current, 16);
+    radio_pack_bits(buffer, &bit, radio_saturate(packet->load_voltage, 0, 0x7fff), 15);
+    radio_pack_bits(buffer, &bit, (uint16_t) packet->load_current, 16);
+    *position = bit;
+
+}
+
+void radio_unpack_reading(const uint8_t* buffer, uint16_t* position, cryo_radio_packet_v2* packet) {
+
+    uint16_t bit = *position;
+    packet->epoch = radio_unpack_bits(buffer, &bit, 32);
+    packet->ds18b20_temperature = (int16_t) radio_unpack_signed(buffer, &bit, 16);
+    packet->pt1000_temperature = radio_unpack_signed(buffer, &bit, 20);
+    packet->raw_adc_value = (int16_t) radio_unpack_signed(buffer, &bit, 16);
+    packet->battery_voltage = (uint16_t) radio_unpack_bits(buffer, &bit, 15);
+    packet->battery_current = (int16_t) radio_unpack_signed(buffer, &bit, 16);
+    packet->solar_panel_voltage = (uint16_t) radio_unpack_bits(buffer, &bit, 15);
+    packet->solar_panel_current = (int16_t) radio_unpack_signed(buffer, &bit, 16);
+    packet->load_voltage = (uint16_t) radio_unpack_bits(buffer, &bit, 15);
+    packet->load_current = (int16_t) radio_unpack_signed(buffer, &bit, 16);
+    *position = bit;
+
+}
+
+uint8_t cryo_radio_encode_packet_v2(const cryo_radio_packet_v2* packet, uint8_t* buffer) {
+
+    uint16_t bit = 0;
+    radio_pack_bits(buffer, &bit, CRYO_RADIO_PACKET_TYPE_V2, 8);
+    radio_pack_bits(buffer, &bit, packet->packet_id, 32);
+    radio_pack_bits(buffer, &bit, packet->sensor_id, 32);
+    radio_pack_reading(buffer, &bit, packet);
+
+    // Clear the padding in the last byte
+    while (bit < CRYO_RADIO_PACKET_V2_LENGTH * 8)
+        radio_pack_bits(buffer, &bit, 0, 1);
+
+    return CRYO_RADIO_PACKET_V2_LENGTH;
+
+}
+
+int32_t cryo_radio_decode_packet_v2(const uint8_t* buffer, uint8_t length, cryo_radio_packet_v2* packet) {
+
+    if (length < CRYO_RADIO_PACKET_V2_LENGTH || buffer[0] != CRYO_RADIO_PACKET_TYPE_V2)
+        return 0;
+
+    uint16_t bit = 8;
+    packet->packet_id = radio_unpack_bits(buffer, &bit, 32);
+    packet->sensor_id = radio_unpack_bits(buffer, &bit, 32);
+    radio_unpack_reading(buffer, &bit, packet);
+
+    return 1;
+
+}
+
+// Fill in a v2 packet with the next packet id, the time and housekeeping values
+void radio_fill_packet_v2(
+    cryo_radio_packet_v2* packet, 
+    int16_t ds18b20_temp, 
+    int32_t pt1000_temp, 
+    int16_t raw_adc_value
+) {
+
+    packet->packet_id = radio_packet.packet_id;
+    packet->sensor_id = radio_packet.sensor_id;
+    packet->epoch = radio_rtc->get_epoch();
+    packet->ds18b20_temperature = ds18b20_temp;
+    packet->pt1000_temperature = pt1000_temp;
+    packet->raw_adc_value = raw_adc_value;
+
+    // Housekeeping values in mV and 0.1 mA
+    cryo_power_snapshot housekeeping;
+    cryo_power_get_snapshot(&housekeeping, radio_housekeeping_max_age);
+    packet->battery_voltage = radio_fixed_point(housekeeping.battery_voltage, 1e3f, 0, 0x7fff);
+    packet->battery_current = radio_fixed_point(housekeeping.battery_current, 1e4f, INT16_MIN, INT16_MAX);
+    packet->solar_panel_voltage = radio_fixed_point(housekeeping.solar_panel_voltage, 1e3f, 0, 0x7fff);
+    packet->solar_panel_current = radio_fixed_point(housekeeping.solar_panel_current, 1e4f, INT16_MIN, INT16_MAX);
+    packet->load_voltage = radio_fixed_point(housekeeping.load_voltage, 1e3f, 0, 0x7fff);
+    packet->load_current = radio_fixed_point(housekeeping.load_current, 1e4f, INT16_MIN, INT16_MAX);
+
+}
+
+int32_t cryo_radio_send_packet_v2(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value) {
+
+    cryo_radio_packet_v2 packet;
+    radio_fill_packet_v2(&packet, ds18b20_temp, pt1000_temp, raw_adc_value);
+
+    uint8_t buffer[CRYO_RADIO_PACKET_V2_LENGTH];
+    uint8_t length = cryo_radio_encode_packet_v2(&packet, buffer);
+    radio_send_frame(buffer, length, packet.packet_id);
+
+    // Increment the sequence id
+    radio_packet.packet_id++;
+
+    return length;
+
+}
+
+int32_t cryo_radio_send_packet_v2_async(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value) {
+
+    cryo_radio_packet_v2 packet;
+    radio_fill_packet_v2(&packet, ds18b20_temp, pt1000_temp, raw_adc_value);
+
+    uint8_t buffer[CRYO_RADIO_PACKET_V2_LENGTH];
+    uint8_t length = cryo_radio_encode_packet_v2(&packet, buffer);
+    if (!cryo_radio_send_async(buffer, length))
+        return 0;
+
+    // Increment the sequence id
+    radio_packet.packet_id++;
+
+    return length;
+
+}
+
+void radio_reading_fields(const cryo_radio_packet_v2* packet, int32_t* values) {
+
+    values[0] = (int32_t) packet->epoch;
+    values[1] = packet->ds18b20_temperature;
+    values[2] = packet->pt1000_temperature;
+    values[3] = packet->raw_adc_value;
+    values[4] = packet->battery_voltage;
+    values[5] = packet->battery_current;
+    values[6] = packet->solar_panel_voltage;
+    values[7] = packet->solar_panel_current;
+    values[8] = packet->load_voltage;
+    values[9] = packet->load_current;
+
+}
+
+void radio_reading_from_fields(const int32_t* values, cryo_radio_packet_v2* packet) {
+
+    packet->epoch = (uint32_t) values[0];
+    packet->ds18b20_temperature = (int16_t) values[1];
+    packet->pt1000_temperature = values[2];
+    packet->raw_adc_value = (int16_t) values[3];
+    packet->battery_voltage = (uint16_t) values[4];
+    packet->battery_current = (int16_t) values[5];
+    packet->solar_panel_voltage = (uint16_t) values[6];
+    packet->solar_panel_current = (int16_t) values[7];
+    packet->load_voltage = (uint16_t) values[8];
+    packet->load_current = (int16_t) values[9];
+
+}
+
+// Start a compressed frame, leaving space for the header
+void radio_batch_start(const cryo_radio_packet_v2* first) {
+
+    radio_batch[0] = *first;
+    radio_batch_frame_length = CRYO_RADIO_BATCH_HEADER_LENGTH;
+    cryo_codec_delta_init(&radio_batch_codec, RADIO_READING_FIELDS);
+
+}
+
+void cryo_radio_batch_configure(uint8_t max_readings, uint32_t max_age) {
+
+    radio_batch_max_readings = max_readings == 0 ? UINT8_MAX : max_readings;
+    radio_batch_max_age = max_age;
+
+}
+
+void cryo_radio_batch_set_compression(bool compress) {
+
+    if (compress != radio_batch_compress)
+        cryo_radio_batch_flush();
+    radio_batch_compress = compress;
+
+}
+
+int32_t cryo_radio_batch_add(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value) {
+
+    int32_t sent = 0;
+    cryo_radio_packet_v2 packet;
+    radio_fill_packet_v2(&packet, ds18b20_temp, pt1000_temp, raw_adc_value);
+    // Readings take consecutive ids, so only the first is sent
+    radio_packet.packet_id++;
+
+    uint8_t max_readings = radio_batch_max_readings;
+    if (radio_batch_compress) {
+        int32_t values[RADIO_READING_FIELDS];
+        radio_reading_fields(&packet, values);
+        if (radio_batch_count == 0)
+            radio_batch_start(&packet);
+
+        uint16_t length = cryo_codec_delta_encode(
+            &radio_batch_codec, 
+            values, 
+            radio_batch_frame + radio_batch_frame_length, 
+            sizeof(radio_batch_frame) - radio_batch_frame_length
+        );
+        if (length == 0) {
+            // The frame is full - send it and start the next with this reading,
+            // which always fits in an empty frame
+            sent = cryo_radio_batch_flush();
+            radio_batch_start(&packet);
+            length = cryo_codec_delta_encode(
+                &radio_batch_codec, 
+                values, 
+                radio_batch_frame + radio_batch_frame_length, 
+                sizeof(radio_batch_frame) - radio_batch_frame_length
+            );
+        }
+        radio_batch_frame_length += length;
+        radio_batch_count++;
+    } else {
+        radio_batch[radio_batch_count++] = packet;
+        if (max_readings > CRYO_RADIO_BATCH_MAX_READINGS)
+            max_readings = CRYO_RADIO_BATCH_MAX_READINGS;
+    }
+
+    if (radio_batch_count >= max_readings)
+        return sent + cryo_radio_batch_flush();
+    return sent + cryo_radio_batch_poll();
+
+}
+
+int32_t cryo_radio_batch_poll() {
+
+    if (radio_batch_count == 0 || radio_batch_max_age == 0)
+        return 0;
+    if (radio_rtc->get_epoch() - radio_batch[0].epoch < radio_batch_max_age)
+        return 0;
+    return cryo_radio_batch_flush();
+
+}
+
+int32_t cryo_radio_batch_flush() {
+
+    if (radio_batch_count == 0)
+        return 0;
+
+    if (radio_batch_compress) {
+        uint16_t bit = 0;
+        radio_pack_bits(radio_batch_frame, &bit, CRYO_RADIO_PACKET_TYPE_BATCH_DELTA, 8);
+        radio_pack_bits(radio_batch_frame, &bit, radio_batch_count, 8);
+        radio_pack_bits(radio_batch_frame, &bit, radio_batch[0].sensor_id, 32);
+        radio_pack_bits(radio_batch_frame, &bit, radio_batch[0].packet_id, 32);
+        radio_send_frame(radio_batch_frame, radio_batch_frame_length, radio_batch[0].packet_id);
+        radio_batch_count = 0;
+        return radio_batch_frame_length;
+    }
+
+    uint8_t buffer[CRYO_RADIO_MAX_MESSAGE_LENGTH];
+    uint16_t bit = 0;
+    radio_pack_bits(buffer, &bit, CRYO_RADIO_PACKET_TYPE_BATCH, 8);
+    radio_pack_bits(buffer, &bit, radio_batch_count, 8);
+    radio_pack_bits(buffer, &bit, radio_batch[0].sensor_id, 32);
+    radio_pack_bits(buffer, &bit, radio_batch[0].packet_id, 32);
+    for (uint8_t k = 0; k < radio_batch_count; k++) {
+        bit = (CRYO_RADIO_BATCH_HEADER_LENGTH + k * CRYO_RADIO_BATCH_RECORD_LENGTH) * 8;
+        radio_pack_reading(buffer, &bit, &radio_batch[k]);
+        // Clear the padding at the end of the record
+        while (bit & 7)
+            radio_pack_bits(buffer, &bit, 0, 1);
+    }
+    uint8_t length = CRYO_RADIO_BATCH_HEADER_LENGTH + radio_batch_count * CRYO_RADIO_BATCH_RECORD_LENGTH;
+
+    radio_send_frame(buffer, length, radio_batch[0].packet_id);
+    radio_batch_count = 0;
+
+    return length;
+
+}
+
+uint8_t cryo_radio_batch_count() {
+    return radio_batch_count;
+}
+
+uint8_t cryo_radio_decode_batch(const uint8_t* buffer, uint8_t length, cryo_radio_packet_v2* packets, uint8_t max_packets) {
+
+    if (length < CRYO_RADIO_BATCH_HEADER_LENGTH)
+        return 0;
+    if (buffer[0] != CRYO_RADIO_PACKET_TYPE_BATCH && buffer[0] != CRYO_RADIO_PACKET_TYPE_BATCH_DELTA)
+        return 0;
+
+    uint16_t bit = 8;
+    uint8_t count = radio_unpack_bits(buffer, &bit, 8);
+    uint32_t sensor_id = radio_unpack_bits(buffer, &bit, 32);
+    uint32_t packet_id = radio_unpack_bits(buffer, &bit, 32);
+
+    if (buffer[0] == CRYO_RADIO_PACKET_TYPE_BATCH_DELTA) {
+        cryo_codec_delta codec;
+        cryo_codec_delta_init(&codec, RADIO_READING_FIELDS);
+        uint16_t position = CRYO_RADIO_BATCH_HEADER_LENGTH;
+        uint8_t decoded = 0;
+        while (decoded < count && decoded < max_packets) {
+            int32_t values[RADIO_READING_FIELDS];
+            uint16_t read = cryo_codec_delta_decode(&codec, buffer + position, length - position, values);
+            if (read == 0)
+                break;
+            position += read;
+            packets[decoded].packet_id = packet_id + decoded;
+            packets[decoded].sensor_id = sensor_id;
+            radio_reading_from_fields(values, &packets[decoded]);
+            decoded++;
+        }
+        return decoded;
+    }
+
+    // Only decode complete records
+    uint8_t available = (length - CRYO_RADIO_BATCH_HEADER_LENGTH) / CRYO_RADIO_BATCH_RECORD_LENGTH;
+    if (count > available) count = available;
+    if (count > max_packets) count = max_packets;
+
+    for (uint8_t k = 0; k < count; k++) {
+        bit = (CRYO_RADIO_BATCH_HEADER_LENGTH + k * CRYO_RADIO_BATCH_RECORD_LENGTH) * 8;
+        packets[k].packet_id = packet_id + k;
+        packets[k].sensor_id = sensor_id;
+        radio_unpack_reading(buffer, &bit, &packets[k]);
+    }
+
+    return count;
+
+}
+
+uint8_t cryo_radio_encode_ack(const cryo_radio_ack* ack, uint8_t* buffer) {
+
+    uint16_t bit = 0;
+    radio_pack_bits(buffer, &bit, CRYO_RADIO_PACKET_TYPE_ACK, 8);
+    radio_pack_bits(buffer, &bit, ack->sensor_id, 32);
+    radio_pack_bits(buffer, &bit, ack->boot, 8);
+    radio_pack_bits(buffer, &bit, ack->sequence, 8);
+    radio_pack_bits(buffer, &bit, ack->bitmap, 32);
+    radio_pack_bits(buffer, &bit, (uint8_t) ack->rssi, 8);
+    radio_pack_bits(buffer, &bit, (uint8_t) ack->snr, 8);
+    return CRYO_RADIO_ACK_LENGTH;
+
+}
+
+int32_t cryo_radio_decode_ack(const uint8_t* buffer, uint8_t length, cryo_radio_ack* ack) {
+
+    if (length < CRYO_RADIO_ACK_LENGTH || buffer[0] != CRYO_RADIO_PACKET_TYPE_ACK)
+        return 0;
+
+    uint16_t bit = 8;
+    ack->sensor_id = radio_unpack_bits(buffer, &bit, 32);
+    ack->boot = radio_unpack_bits(buffer, &bit, 8);
+    ack->sequence = radio_unpack_bits(buffer, &bit, 8);
+    ack->bitmap = radio_unpack_bits(buffer, &bit, 32);
+    ack->rssi = radio_unpack_signed(buffer, &bit, 8);
+    ack->snr = radio_unpack_signed(buffer, &bit, 8);
+    return 1;
+
+}
+
+uint8_t cryo_radio_send_ack(const cryo_radio_ack* tracker, int16_t rssi, int8_t snr) {
+
+    cryo_radio_ack ack = *tracker;
+    ack.rssi = rssi < INT8_MIN ? INT8_MIN : rssi > INT8_MAX ? INT8_MAX : rssi;
+    ack.snr = snr;
+
+    uint8_t buffer[CRYO_RADIO_ACK_LENGTH];
+    cryo_radio_encode_ack(&ack, buffer);
+    // The gateway's radio stays on to keep listening
+    rf95.send(buffer, CRYO_RADIO_ACK_LENGTH);
+    uint8_t sent = rf95.waitPacketSent(250);
+    if (radio_rx_enabled)
+        rf95.setModeRx();
+    return sent;
+
+}
+
+uint8_t cryo_radio_frame_ids(const uint8_t* buffer, uint8_t length, uint32_t* sensor_id, uint32_t* packet_id) {
+
+    uint16_t bit = 8;
+    if (length == 0)
+        return 0;
+    switch (buffer[0]) {
+        case CRYO_RADIO_PACKET_TYPE:
+            if (length < sizeof(cryo_radio_packet))
+                return 0;
+            memcpy(packet_id, buffer + offsetof(cryo_radio_packet, packet_id), sizeof(uint32_t));
+            memcpy(sensor_id, buffer + offsetof(cryo_radio_packet, sensor_id), sizeof(uint32_t));
+            return 1;
+        case CRYO_RADIO_PACKET_TYPE_V2:
+            if (length < CRYO_RADIO_PACKET_V2_LENGTH)
+                return 0;
+            *packet_id = radio_unpack_bits(buffer, &bit, 32);
+            *sensor_id = radio_unpack_bits(buffer, &bit, 32);
+            return 1;
+        case CRYO_RADIO_PACKET_TYPE_BATCH:
+        case CRYO_RADIO_PACKET_TYPE_BATCH_DELTA:
+            if (length < CRYO_RADIO_BATCH_HEADER_LENGTH)
+                return 0;
+            bit += 8;
+            *sensor_id = radio_unpack_bits(buffer, &bit, 32);
+            *packet_id = radio_unpack_bits(buffer, &bit, 32);
+            return 1;
+    }
+    return 0;
+
+}
+
+int32_t cryo_radio_receive_frame(uint8_t* buffer, uint8_t* length, int16_t* rssi, int8_t* snr) {
+
+    if (!rf95.available() || !rf95.recv(buffer, length))
+        return 0;
+    *rssi = rf95.lastRssi();
+    *snr = rf95.lastSNR();
+    return 1;
+
+}
+
+void cryo_radio_frame_sequence(uint8_t* boot, uint8_t* sequence) {
+
+    *boot = rf95.headerFrom();
+    *sequence = rf95.headerId();
+
+}
+
+void cryo_radio_rx_start() {
+
+    noInterrupts();
+    radio_rx_head = 0;
+    radio_rx_tail = 0;
+    radio_rx_count = 0;
+    radio_rx_enabled = true;
+    interrupts();
+    cryo_radio_enable();
+    rf95.setModeRx();
+
+}
+
+void cryo_radio_rx_stop() {
+
+    radio_rx_enabled = false;
+    rf95.setModeIdle();
+
+}
+
+cryo_radio_rx_frame* cryo_radio_rx_peek() {
+
+    // A frame stored after the count is read only adds to the head
+    if (radio_rx_count == 0)
+        return NULL;
+    return &radio_rx_pool[radio_rx_tail];
+
+}
+
+void cryo_radio_rx_release() {
+
+    noInterrupts();
+    if (radio_rx_count > 0) {
+        radio_rx_tail = (radio_rx_tail + 1) % CRYO_RADIO_RX_POOL_SIZE;
+        radio_rx_count--;
+    }
+    interrupts();
+
+}
+
+uint8_t cryo_radio_rx_count() {
+
+    return radio_rx_count;
+
+}
+
+void cryo_radio_rx_get_stats(cryo_radio_rx_stats* stats) {
+
+    noInterrupts();
+    stats->received = radio_rx_received;
+    stats->overflows = radio_rx_overflows;
+    interrupts();
+    stats->crc_errors = rf95.rxBad();
+
+}
+
 int32_t cryo_radio_receive_packet(cryo_radio_packet* packet) {
 
     int32_t rssi = -999;
@@ -42,6 +42,7 @@ EXAMPLE USAGE:
 
 #include <Arduino.h>
 #include "cryo_sleep.h"
+#include "cryo_codec.h"
 
 #ifndef CRYO_RADIO_H
 #define CRYO_RADIO_H
@@ -64,6 +65,16 @@ EXAMPLE USAGE:
 #define CRYO_PIN_RADIO_CS 10
 #endif 
 
+/*
+    Radio Resume Timeout
+    --------------------
+    Longest time in microseconds to wait for the RFM96 to come out of reset
+    after cryo_radio_enable() before restoring its configuration.
+*/
+#ifndef CRYO_RADIO_RESUME_TIMEOUT_US
+#define CRYO_RADIO_RESUME_TIMEOUT_US 10000
+#endif
+
 /* 
     Radio Packet Type
     -----------------
@@ -72,9 +83,23 @@ EXAMPLE USAGE:
     types can be sent and - critically - identified at ther receiver
     to be properly decoded.
 
-    For now, all packets should use the default CRYO_RADIO_PACKET_TYPE.
+    CRYO_RADIO_PACKET_TYPE is the original packet (cryo_radio_packet), sent
+    as the raw struct.  CRYO_RADIO_PACKET_TYPE_V2 is the compact, bit-packed
+    packet (cryo_radio_packet_v2) sent by cryo_radio_send_packet_v2().  The
+    type is always the first byte of the frame.  CRYO_RADIO_PACKET_TYPE_BATCH
+    frames carry several v2 readings, see cryo_radio_batch_add(), and 
+    CRYO_RADIO_PACKET_TYPE_BATCH_DELTA frames carry them compressed.
+    CRYO_RADIO_PACKET_TYPE_ACK frames are sent by the gateway in reliable
+    mode, see cryo_radio_reliable_configure().
 */
 #define CRYO_RADIO_PACKET_TYPE 0xC5
+#define CRYO_RADIO_PACKET_TYPE_V2 0xC6
+#define CRYO_RADIO_PACKET_TYPE_BATCH 0xC7
+#define CRYO_RADIO_PACKET_TYPE_BATCH_DELTA 0xC8
+#define CRYO_RADIO_PACKET_TYPE_ACK 0xC9
+
+// Largest frame the RFM96 driver can send (RH_RF95_MAX_MESSAGE_LEN)
+#define CRYO_RADIO_MAX_MESSAGE_LENGTH 251
 
 /*
     Radio Packet Structure
@@ -98,6 +123,214 @@ typedef struct cryo_radio_packet {
     char timestamp[CRYO_RTC_TIMESTAMP_LENGTH];
 } cryo_radio_packet;
 
+/*
+    Radio Packet Structure (v2)
+    ---------------------------
+    Fixed-point version of the packet, with an epoch timestamp in place of 
+    the text timestamp.  On air, the fields are packed MSB first, in order,
+    into CRYO_RADIO_PACKET_V2_LENGTH bytes with the following widths:
+
+        packet_type             8 bits      CRYO_RADIO_PACKET_TYPE_V2
+        packet_id               32 bits
+        sensor_id               32 bits
+        epoch                   32 bits     seconds since 1 Jan 1970
+        ds18b20_temperature     16 bits     signed, 0.01 degrees C
+        pt1000_temperature      20 bits     signed, 0.001 degrees C (+/-524 C)
+        raw_adc_value           16 bits     signed ADC result
+        battery_voltage         15 bits     mV (up to 32.767 V)
+        battery_current         16 bits     signed, 0.1 mA (+/-3.2768 A)
+        solar_panel_voltage     15 bits
+        solar_panel_current     16 bits
+        load_voltage            15 bits
+        load_current            16 bits
+
+    Values out of range are saturated when encoding.
+*/
+#define CRYO_RADIO_PACKET_V2_LENGTH 32
+
+typedef struct cryo_radio_packet_v2 {
+    uint32_t packet_id;
+    uint32_t sensor_id;
+    uint32_t epoch;
+    int16_t ds18b20_temperature;
+    int32_t pt1000_temperature;
+    int16_t raw_adc_value;
+    uint16_t battery_voltage;
+    int16_t battery_current;
+    uint16_t solar_panel_voltage;
+    int16_t solar_panel_current;
+    uint16_t load_voltage;
+    int16_t load_current;
+} cryo_radio_packet_v2;
+
+/*
+    Batch Frame Structure
+    ---------------------
+    A batch frame carries up to CRYO_RADIO_BATCH_MAX_READINGS readings from 
+    one sensor with consecutive packet ids:
+
+        packet_type             8 bits      CRYO_RADIO_PACKET_TYPE_BATCH
+        count                   8 bits      number of readings
+        sensor_id               32 bits
+        packet_id               32 bits     id of the first reading
+        readings                CRYO_RADIO_BATCH_RECORD_LENGTH bytes each,
+                                the v2 fields from epoch onwards, packed
+                                as in the v2 packet
+
+    A compressed batch frame (CRYO_RADIO_PACKET_TYPE_BATCH_DELTA) has the same 
+    header, followed by the same ten fields of each reading delta encoded with 
+    cryo_codec_delta (see cryo_codec.h), so it holds as many readings as fit.
+*/
+#define CRYO_RADIO_BATCH_HEADER_LENGTH 10
+#define CRYO_RADIO_BATCH_RECORD_LENGTH 23
+#define CRYO_RADIO_BATCH_MAX_READINGS \
+    ((CRYO_RADIO_MAX_MESSAGE_LENGTH - CRYO_RADIO_BATCH_HEADER_LENGTH) / CRYO_RADIO_BATCH_RECORD_LENGTH)
+
+/*
+    Frame Sequence
+    --------------
+    Every frame is sent with RadioHead's four byte header, which carries:
+
+        FROM                    boot nonce, chosen at random by cryo_radio_init()
+        ID                      sequence number, counting frames (not readings)
+                                as they are first transmitted
+
+    A resent frame keeps its sequence number, so the gateway can acknowledge
+    and spot duplicates of whole frames however many readings they hold, and 
+    a change of boot nonce shows that the sensor has restarted.  On the 
+    gateway, see cryo_radio_frame_sequence() or cryo_radio_rx_frame.
+*/
+
+/*
+    Acknowledgement Frame Structure
+    -------------------------------
+    In reliable mode the gateway replies to each frame with an acknowledgement
+    of the most recent frames received from that sensor, packed MSB first:
+
+        packet_type             8 bits      CRYO_RADIO_PACKET_TYPE_ACK
+        sensor_id               32 bits
+        boot                    8 bits      boot nonce of the frames acknowledged
+        sequence                8 bits      newest frame sequence number received
+        bitmap                  32 bits     bit k set if sequence - k was received
+        rssi                    8 bits      signed, dBm of the frame at the gateway
+        snr                     8 bits      signed, dB of the frame at the gateway
+
+    The same struct is used by the gateway to track each sensor.
+*/
+#define CRYO_RADIO_ACK_LENGTH 13
+
+typedef struct cryo_radio_ack {
+    uint32_t sensor_id;
+    uint8_t boot;
+    uint8_t sequence;
+    uint32_t bitmap;
+    int8_t rssi;
+    int8_t snr;
+} cryo_radio_ack;
+
+/*
+    Reliable Mode History
+    ---------------------
+    Number of sent frames kept in RAM until they are acknowledged.  Each
+    takes CRYO_RADIO_MAX_MESSAGE_LENGTH bytes.
+*/
+#ifndef CRYO_RADIO_RELIABLE_HISTORY
+#define CRYO_RADIO_RELIABLE_HISTORY 4
+#endif
+
+/*
+    Link Settings
+    -------------
+    Data rates are numbered from 0 (SF12, the most robust) to 
+    CRYO_RADIO_DATA_RATES - 1 (SF7, the fastest and RadioHead's default), 
+    all with 125 kHz bandwidth and coding rate 4/5.  Each step roughly halves
+    the time on air, and needs about 2.5 dB more SNR.  Transmit power is in 
+    dBm from CRYO_RADIO_TX_POWER_MIN to CRYO_RADIO_TX_POWER_MAX.
+*/
+#define CRYO_RADIO_DATA_RATES 6
+#define CRYO_RADIO_TX_POWER_MIN 5
+#define CRYO_RADIO_TX_POWER_MAX 23
+
+/*
+    Adaptive Data Rate
+    ------------------
+    CRYO_RADIO_ADR_HISTORY acknowledgements are collected between changes,
+    and the best SNR among them must exceed the data rate's limit by 
+    CRYO_RADIO_ADR_MARGIN_DB before speeding up or reducing power.  After 
+    CRYO_RADIO_ADR_LOSS_LIMIT frames in a row without an acknowledgement the
+    link falls back to more robust settings.
+*/
+#ifndef CRYO_RADIO_ADR_HISTORY
+#define CRYO_RADIO_ADR_HISTORY 8
+#endif
+#ifndef CRYO_RADIO_ADR_MARGIN_DB
+#define CRYO_RADIO_ADR_MARGIN_DB 10
+#endif
+#ifndef CRYO_RADIO_ADR_LOSS_LIMIT
+#define CRYO_RADIO_ADR_LOSS_LIMIT 3
+#endif
+
+/*
+    Time-Division Slot Statistics
+    -----------------------------
+    Counters kept by the radio, see cryo_radio_tdma_configure().
+
+        frames_in_slot          frames sent in this logger's slot
+        slot_misses             frames sent (or queued) outside the slot
+        collisions              slots where another transmission was heard
+                                before sending (channel activity detection)
+        ack_timeouts            frames with no acknowledgement in reliable mode
+*/
+typedef struct cryo_radio_tdma_stats {
+    uint32_t frames_in_slot;
+    uint32_t slot_misses;
+    uint32_t collisions;
+    uint32_t ack_timeouts;
+} cryo_radio_tdma_stats;
+
+/*
+    Time-Division Slot Hold
+    -----------------------
+    Number of frames sent outside the slot that are kept in RAM until the 
+    slot starts, when the SD card queue isn't enabled.  Each takes 
+    CRYO_RADIO_MAX_MESSAGE_LENGTH bytes.
+*/
+#ifndef CRYO_RADIO_TDMA_HELD
+#define CRYO_RADIO_TDMA_HELD 2
+#endif
+
+/*
+    Receive Engine
+    --------------
+    Frames received by the gateway's RxDone interrupt are held in a ring of 
+    CRYO_RADIO_RX_POOL_SIZE buffers, each CRYO_RADIO_MAX_MESSAGE_LENGTH bytes, 
+    with their signal strength, SNR, arrival time (millis()) and boot nonce
+    and sequence number (see Frame Sequence).  Statistics:
+
+        received                frames stored in the ring
+        overflows               frames dropped because the ring was full
+        crc_errors              frames with a bad CRC, e.g. from collisions
+*/
+#ifndef CRYO_RADIO_RX_POOL_SIZE
+#define CRYO_RADIO_RX_POOL_SIZE 8
+#endif
+
+typedef struct cryo_radio_rx_frame {
+    uint32_t timestamp;
+    int16_t rssi;
+    int8_t snr;
+    uint8_t boot;
+    uint8_t sequence;
+    uint8_t length;
+    uint8_t data[CRYO_RADIO_MAX_MESSAGE_LENGTH];
+} cryo_radio_rx_frame;
+
+typedef struct cryo_radio_rx_stats {
+    uint32_t received;
+    uint32_t overflows;
+    uint32_t crc_errors;
+} cryo_radio_rx_stats;
+
 /*
     name:           cryo_radio_init(uint32_t sensor_id, PseudoRTC* rtc)
     description:    Initialises the RFM96 radio module and packet structure 
@@ -119,7 +352,8 @@ uint8_t cryo_radio_init(uint32_t sensor_id, PseudoRTC* rtc);
 /*
     name:           cryo_radio_enable()
     description:    pulls the pin defined by CRYO_PIN_RADIO_ENABLE high to switch
-                    on the RFM96 module.
+                    on the RFM96 module, then restores the configuration saved
+                    by cryo_radio_init() (see cryo_radio_get_resume_micros()).
     arguments:      none
     returns:        none
 */
@@ -134,6 +368,32 @@ void cryo_radio_enable();
 */
 void cryo_radio_disable();
 
+/*
+    name:           cryo_radio_set_housekeeping_max_age(uint32_t max_age)
+    description:    sets how old the housekeeping snapshot (see cryo_power.h) 
+                    sent with each reading can be before it is taken again.  
+                    Taking the snapshot ahead of time with cryo_power_sample() 
+                    keeps the I2C reads out of the send path.
+    arguments:      max_age
+                        - oldest snapshot to send in seconds, or 0 (the default)
+                          to take a new one for every reading
+    returns:        none
+*/
+void cryo_radio_set_housekeeping_max_age(uint32_t max_age);
+
+/*
+    name:           cryo_radio_get_resume_micros()
+    description:    switching off the RFM96 loses its configuration, so the 
+                    registers set up by cryo_radio_init() are saved and written
+                    back in one SPI burst by cryo_radio_enable(), once LoRa 
+                    mode has been selected (which takes about 10 ms).  Returns
+                    how long the last power-up took, from switching on to ready
+                    to transmit.
+    arguments:      none
+    returns:        time in microseconds
+*/
+uint32_t cryo_radio_get_resume_micros();
+
 /*
     name:           cryo_radio_send_packet(...)
     description:    sends a cryo_radio packet using the RFM96 radio module with
@@ -160,6 +420,571 @@ void cryo_radio_disable();
 int32_t cryo_radio_send_packet(float_t ds18b20_temp, float_t pt1000_temp);
 int32_t cryo_radio_send_packet(float_t ds18b20_temp, float_t pt1000_temp, uint32_t raw_adc_value);
 
+/*
+    name:           cryo_radio_send_packet_v2(...)
+    description:    sends a compact v2 packet (see cryo_radio_packet_v2) with the 
+                    temperature data, ADC value, housekeeping information and 
+                    the current epoch time.  Shares the packet_id sequence with
+                    cryo_radio_send_packet().
+    arguments:      
+                    int16_t ds18b20_temp
+                    - temperature in hundredths of a degree Celcius read by the 
+                      DS18B20 digital temperature sensor
+
+                    int32_t pt1000_temp
+                    - temperature in thousandths of a degree Celcius, e.g. from 
+                      cryo_pt1000_read_millidegrees()
+
+                    int16_t raw_adc_value
+                    - raw ADC result
+                       
+    returns:        returns the size of the transmitted packet
+*/
+int32_t cryo_radio_send_packet_v2(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value);
+
+/*
+    name:           cryo_radio_queue_configure(bool enable, uint8_t frames_per_send, uint32_t interval_ms)
+    description:    keeps frames that couldn't be sent in a queue on the SD card 
+                    (see cryo_queue.h), and sends them, oldest first, once 
+                    the link is working again.  To keep packet_id order, while
+                    the queue holds frames each new frame is added to its end
+                    and up to frames_per_send frames are sent from its start,
+                    interval_ms apart, so frames_per_send should be more than 1
+                    for the queue to catch up.  Frames sent with 
+                    cryo_radio_send_async() aren't queued.
+    arguments:      enable
+                        - true to queue frames, which starts the SD card
+                    frames_per_send
+                        - most queued frames to send with each new frame, or 0 
+                          to send them only with cryo_radio_queue_drain()
+                    interval_ms
+                        - gap between queued frames in milliseconds, to limit 
+                          the duty cycle.  The processor waits awake through 
+                          the gap, so keep it short (or 0, letting the radio's
+                          own airtime space the frames).
+    returns:        1 if successful, 0 if the SD card couldn't be started
+*/
+uint8_t cryo_radio_queue_configure(bool enable, uint8_t frames_per_send, uint32_t interval_ms);
+
+/*
+    name:           cryo_radio_queue_drain(uint16_t max_frames)
+    description:    sends queued frames, oldest first, stopping at the first frame 
+                    that fails
+    arguments:      max_frames
+                        - most frames to send
+    returns:        number of frames sent
+*/
+uint16_t cryo_radio_queue_drain(uint16_t max_frames);
+
+/*
+    name:           cryo_radio_tdma_configure(uint32_t frame_seconds, uint16_t slots, void (*callback)())
+    description:    shares the channel between loggers by time.  The time is split
+                    into frames of frame_seconds, aligned to the epoch time, and 
+                    each frame into slots; the logger transmits in slot 
+                    sensor_id % slots.  Loggers need their clocks set to within
+                    a fraction of the slot length.  Frames sent outside the slot
+                    are counted and held until the slot starts - in the SD card
+                    queue if it is enabled, otherwise in RAM (the newest 
+                    CRYO_RADIO_TDMA_HELD frames).  At the start of the slot an
+                    alarm on the PseudoRTC given to cryo_radio_init(), raised by
+                    cryo_raise_alarms() (or its raise_alarms()), sends the held
+                    frames and then calls the callback, e.g. to take and send a
+                    reading, or without one sends some of the queue.  Sending
+                    from the callback avoids holding readings for a whole 
+                    frame.  The radio listens before each frame, and backs off
+                    briefly if the slot is in use.
+    example:
+                    // 60 loggers sharing a 10 minute frame, 10 s each
+                    cryo_radio_tdma_configure(600, 60, take_reading);
+
+    arguments:      frame_seconds
+                        - length of the frame in seconds, i.e. how often each 
+                          logger transmits
+                    slots
+                        - number of slots in the frame, at least the number of 
+                          loggers and no more than frame_seconds
+                    callback
+                        - function to call at the start of the slot, or NULL
+    returns:        this logger's slot
+*/
+uint16_t cryo_radio_tdma_configure(uint32_t frame_seconds, uint16_t slots, void (*callback)());
+
+/*
+    name:           cryo_radio_tdma_disable()
+    description:    stops restricting transmissions to the slot and removes the 
+                    slot alarm, sending any frames held in RAM for the slot
+    arguments:      none
+    returns:        none
+*/
+void cryo_radio_tdma_disable();
+
+/*
+    name:           cryo_radio_tdma_in_slot()
+    description:    checks whether the current time is within this logger's slot
+    arguments:      none
+    returns:        1 if in the slot (or slots aren't in use), 0 otherwise
+*/
+uint8_t cryo_radio_tdma_in_slot();
+
+/*
+    name:           cryo_radio_tdma_get_stats(cryo_radio_tdma_stats* stats)
+    description:    copies the slot and collision counters
+    arguments:      stats
+                        - pointer to the counters to fill in
+    returns:        none
+*/
+void cryo_radio_tdma_get_stats(cryo_radio_tdma_stats* stats);
+
+/*
+    name:           cryo_radio_set_link(uint8_t data_rate, int8_t tx_power)
+    description:    sets the data rate and transmit power, which are programmed
+                    the next time the radio is switched on to transmit and 
+                    restored after that
+    arguments:      data_rate
+                        - 0 (SF12) to CRYO_RADIO_DATA_RATES - 1 (SF7)
+                    tx_power
+                        - transmit power in dBm, CRYO_RADIO_TX_POWER_MIN to 
+                          CRYO_RADIO_TX_POWER_MAX
+    returns:        none
+*/
+void cryo_radio_set_link(uint8_t data_rate, int8_t tx_power);
+
+/*
+    name:           cryo_radio_get_data_rate()
+    description:    returns the current data rate
+    arguments:      none
+    returns:        0 (SF12) to CRYO_RADIO_DATA_RATES - 1 (SF7)
+*/
+uint8_t cryo_radio_get_data_rate();
+
+/*
+    name:           cryo_radio_get_tx_power()
+    description:    returns the current transmit power
+    arguments:      none
+    returns:        transmit power in dBm
+*/
+int8_t cryo_radio_get_tx_power();
+
+/*
+    name:           cryo_radio_adr_configure(bool enable, bool adapt_data_rate)
+    description:    adapts the transmit power, and optionally the data rate, to 
+                    the link margin, using the SNR the gateway reports in its
+                    acknowledgements (so reliable mode must be on).  Loggers 
+                    close to the gateway use less power and, with 
+                    adapt_data_rate, less time on air.  The RFM96 only receives
+                    at one data rate, so adapt_data_rate should only be set if 
+                    the gateway can receive every data rate.
+    arguments:      enable
+                        - true to adapt the link settings
+                    adapt_data_rate
+                        - true to change the data rate as well as the power
+    returns:        none
+*/
+void cryo_radio_adr_configure(bool enable, bool adapt_data_rate);
+
+/*
+    name:           cryo_radio_reliable_configure(bool enable, uint16_t window_ms, uint8_t max_retries)
+    description:    switches reliable mode on or off.  In reliable mode the radio 
+                    listens for window_ms after each transmission for the 
+                    gateway's acknowledgement, and resends only the frames it 
+                    shows as missing.  Frames that are still missing after 
+                    max_retries resends go to the end of the SD card queue if it 
+                    is enabled (see cryo_radio_queue_configure()), so they are
+                    the only frames sent out of packet_id order.  Frames with no
+                    acknowledgement at all are kept and checked against the 
+                    next one; once CRYO_RADIO_RELIABLE_HISTORY frames are 
+                    waiting, new frames are queued and the oldest is resent 
+                    instead (without the queue, the oldest is dropped).
+    arguments:      enable
+                        - true for reliable mode
+                    window_ms
+                        - time to listen for an acknowledgement in milliseconds
+                    max_retries
+                        - most times to resend a frame
+    returns:        none
+*/
+void cryo_radio_reliable_configure(bool enable, uint16_t window_ms, uint8_t max_retries);
+
+/*
+    name:           cryo_radio_reliable_pending()
+    description:    returns the number of sent frames waiting to be acknowledged
+    arguments:      none
+    returns:        number of frames
+*/
+uint8_t cryo_radio_reliable_pending();
+
+/*
+    name:           cryo_radio_get_last_ack(cryo_radio_ack* ack)
+    description:    copies the last acknowledgement received, which includes the
+                    signal strength and SNR measured by the gateway
+    arguments:      ack
+                        - pointer to the acknowledgement to fill in
+    returns:        1 if an acknowledgement has been received, 0 otherwise
+*/
+uint8_t cryo_radio_get_last_ack(cryo_radio_ack* ack);
+
+/*
+    name:           cryo_radio_ack_contains(const cryo_radio_ack* ack, uint8_t sequence)
+    description:    checks whether an acknowledgement covers a frame
+    arguments:      ack
+                        - pointer to the acknowledgement
+                    sequence
+                        - sequence number of the frame
+    returns:        1 if the frame was received by the gateway, 0 otherwise
+*/
+uint8_t cryo_radio_ack_contains(const cryo_radio_ack* ack, uint8_t sequence);
+
+/*
+    name:           cryo_radio_ack_tracker_init(cryo_radio_ack* tracker, uint32_t sensor_id)
+    description:    (gateway) starts tracking the frames received from a sensor
+    arguments:      tracker
+                        - pointer to the tracker for this sensor
+                    sensor_id
+                        - id of the sensor
+    returns:        none
+*/
+void cryo_radio_ack_tracker_init(cryo_radio_ack* tracker, uint32_t sensor_id);
+
+/*
+    name:           cryo_radio_ack_tracker_record(cryo_radio_ack* tracker, uint8_t boot, uint8_t sequence)
+    description:    (gateway) records that a frame from the sensor was received.
+                    Duplicates are recognised within the last 32 sequence 
+                    numbers, which covers every frame the sensor can still 
+                    resend while CRYO_RADIO_RELIABLE_HISTORY * (max_retries + 1)
+                    is under 32 (see cryo_radio_reliable_configure()).  A new
+                    boot nonce restarts the window, as the 
+                    sensor has been reset, and so does a frame 32 or more 
+                    sequence numbers behind the newest, which only happens 
+                    once the gateway has missed about 100 frames in a row.
+    arguments:      tracker
+                        - pointer to the tracker for the sensor
+                    boot, sequence
+                        - boot nonce and sequence number of the frame, from
+                          cryo_radio_frame_sequence() or cryo_radio_rx_frame
+    returns:        1 if the frame is new, 0 if it is a resend that was already received
+*/
+uint8_t cryo_radio_ack_tracker_record(cryo_radio_ack* tracker, uint8_t boot, uint8_t sequence);
+
+/*
+    name:           cryo_radio_send_ack(const cryo_radio_ack* tracker, int16_t rssi, int8_t snr)
+    description:    (gateway) sends an acknowledgement to the sensor.  Should be 
+                    sent straight after each frame is received, within the 
+                    sensor's window.  The radio is left on.
+    arguments:      tracker
+                        - pointer to the tracker for the sensor
+                    rssi, snr
+                        - signal strength and SNR of the received frame
+    returns:        1 if sent, 0 otherwise
+*/
+uint8_t cryo_radio_send_ack(const cryo_radio_ack* tracker, int16_t rssi, int8_t snr);
+
+/*
+    name:           cryo_radio_encode_ack(const cryo_radio_ack* ack, uint8_t* buffer)
+    description:    packs an acknowledgement into its on-air form
+    arguments:      ack
+                        - pointer to the acknowledgement
+                    buffer
+                        - pointer to at least CRYO_RADIO_ACK_LENGTH bytes
+    returns:        number of bytes written (CRYO_RADIO_ACK_LENGTH)
+*/
+uint8_t cryo_radio_encode_ack(const cryo_radio_ack* ack, uint8_t* buffer);
+
+/*
+    name:           cryo_radio_decode_ack(const uint8_t* buffer, uint8_t length, cryo_radio_ack* ack)
+    description:    unpacks a received acknowledgement
+    arguments:      buffer
+                        - pointer to the received frame
+                    length
+                        - length of the received frame
+                    ack
+                        - pointer to the acknowledgement to fill in
+    returns:        1 if the frame is an acknowledgement, 0 otherwise
+*/
+int32_t cryo_radio_decode_ack(const uint8_t* buffer, uint8_t length, cryo_radio_ack* ack);
+
+/*
+    name:           cryo_radio_frame_ids(const uint8_t* buffer, uint8_t length, uint32_t* sensor_id, uint32_t* packet_id)
+    description:    reads the sensor and packet ids from any type of sensor frame
+    arguments:      buffer
+                        - pointer to the received frame
+                    length
+                        - length of the received frame
+                    sensor_id, packet_id
+                        - set to the ids from the frame
+    returns:        1 if the frame is a sensor frame, 0 otherwise
+*/
+uint8_t cryo_radio_frame_ids(const uint8_t* buffer, uint8_t length, uint32_t* sensor_id, uint32_t* packet_id);
+
+/*
+    name:           cryo_radio_receive_frame(uint8_t* buffer, uint8_t* length, int16_t* rssi, int8_t* snr)
+    description:    collects a received frame of any type, leaving the radio 
+                    listening
+    arguments:      buffer
+                        - buffer for the frame
+                    length
+                        - size of the buffer, set to the frame length
+                    rssi, snr
+                        - set to the signal strength and SNR of the frame
+    returns:        1 if a frame was received, 0 otherwise
+*/
+int32_t cryo_radio_receive_frame(uint8_t* buffer, uint8_t* length, int16_t* rssi, int8_t* snr);
+
+/*
+    name:           cryo_radio_frame_sequence(uint8_t* boot, uint8_t* sequence)
+    description:    (gateway) reads the boot nonce and sequence number (see 
+                    Frame Sequence) of the last frame collected by 
+                    cryo_radio_receive_frame()
+    arguments:      boot, sequence
+                        - set to the values from the frame's header
+    returns:        none
+*/
+void cryo_radio_frame_sequence(uint8_t* boot, uint8_t* sequence);
+
+/*
+    name:           cryo_radio_send_async(const uint8_t* data, uint8_t length)
+    description:    switches on the radio, loads a frame into its FIFO and starts 
+                    transmitting, then returns without waiting.  When the RFM96 
+                    raises TxDone on CRYO_PIN_RADIO_IRQ the callback set by 
+                    cryo_radio_set_async_callback() is called, so the processor 
+                    can cryo_sleep() through the transmission.  The radio is 
+                    switched off and the EIC returned to its clock by the next 
+                    call to cryo_radio_async_busy(), cryo_radio_async_wait() or a 
+                    send function, not by the interrupt.  The data is copied, so 
+                    the buffer can be reused straight away.
+    example:
+                    volatile bool radio_done = false;
+                    void on_sent(uint8_t sent) { radio_done = true; }
+
+                    cryo_radio_set_async_callback(on_sent);
+                    cryo_radio_send_packet_v2_async(ds18b20, pt1000, raw);
+                    while (!radio_done) cryo_sleep();
+                    cryo_radio_async_wait(0);  // switch the radio off
+
+    arguments:      data
+                        - pointer to the frame to send
+                    length
+                        - length of the frame, up to CRYO_RADIO_MAX_MESSAGE_LENGTH
+    returns:        length of the frame, or 0 if it couldn't be sent (e.g. a 
+                    transmission is already in progress)
+*/
+int32_t cryo_radio_send_async(const uint8_t* data, uint8_t length);
+
+/*
+    name:           cryo_radio_send_packet_v2_async(...)
+    description:    as cryo_radio_send_packet_v2(), but transmits with 
+                    cryo_radio_send_async()
+    arguments:      as cryo_radio_send_packet_v2()
+    returns:        size of the packet, or 0 if it couldn't be sent
+*/
+int32_t cryo_radio_send_packet_v2_async(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value);
+
+/*
+    name:           cryo_radio_set_async_callback(void (*callback)(uint8_t sent))
+    description:    sets the function called, from the radio interrupt, when an 
+                    asynchronous transmission ends
+    arguments:      callback
+                        - function taking 1 if the frame was sent or 0 if the 
+                          transmission was cancelled, or NULL for none
+    returns:        none
+*/
+void cryo_radio_set_async_callback(void (*callback)(uint8_t sent));
+
+/*
+    name:           cryo_radio_async_busy()
+    description:    checks whether an asynchronous transmission is in progress, 
+                    switching off the radio once it has ended
+    arguments:      none
+    returns:        true until the transmission ends
+*/
+bool cryo_radio_async_busy();
+
+/*
+    name:           cryo_radio_async_wait(uint32_t timeout_ms)
+    description:    waits for an asynchronous transmission to end, cancelling it 
+                    if it takes longer than timeout_ms, then switches off the 
+                    radio.  The blocking send functions call this before using 
+                    the radio.
+    arguments:      timeout_ms
+                        - longest time to wait in milliseconds
+    returns:        1 if the transmission ended (or none was in progress), 0 if 
+                    it was cancelled
+*/
+uint8_t cryo_radio_async_wait(uint32_t timeout_ms);
+
+/*
+    name:           cryo_radio_async_cancel()
+    description:    abandons an asynchronous transmission and switches off the radio
+    arguments:      none
+    returns:        none
+*/
+void cryo_radio_async_cancel();
+
+/*
+    name:           cryo_radio_encode_packet_v2(const cryo_radio_packet_v2* packet, uint8_t* buffer)
+    description:    packs a v2 packet into its on-air form
+    arguments:      packet
+                        - pointer to the packet to encode
+                    buffer
+                        - pointer to at least CRYO_RADIO_PACKET_V2_LENGTH bytes
+    returns:        number of bytes written (CRYO_RADIO_PACKET_V2_LENGTH)
+*/
+uint8_t cryo_radio_encode_packet_v2(const cryo_radio_packet_v2* packet, uint8_t* buffer);
+
+/*
+    name:           cryo_radio_decode_packet_v2(const uint8_t* buffer, uint8_t length, cryo_radio_packet_v2* packet)
+    description:    unpacks a received v2 packet
+    arguments:      buffer
+                        - pointer to the received frame
+                    length
+                        - length of the received frame
+                    packet
+                        - pointer to the packet to fill in
+    returns:        1 if the frame is a v2 packet, 0 otherwise
+*/
+int32_t cryo_radio_decode_packet_v2(const uint8_t* buffer, uint8_t length, cryo_radio_packet_v2* packet);
+
+/*
+    name:           cryo_radio_batch_configure(uint8_t max_readings, uint32_t max_age)
+    description:    sets when the batch of readings is sent.  By default the 
+                    batch is sent when it is full.
+    arguments:      max_readings
+                        - number of readings that triggers a send, up to 
+                          CRYO_RADIO_BATCH_MAX_READINGS (or 255 with compression),
+                          or 0 to send only when the frame is full
+                    max_age
+                        - age in seconds of the oldest reading that triggers a 
+                          send, or 0 to send on count alone
+    returns:        none
+*/
+void cryo_radio_batch_configure(uint8_t max_readings, uint32_t max_age);
+
+/*
+    name:           cryo_radio_batch_add(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value)
+    description:    records a reading, with the housekeeping information and epoch 
+                    time, in the batch held in RAM (arguments as 
+                    cryo_radio_send_packet_v2()).  The radio is only switched on
+                    when the batch reaches the configured count or age, or is full.
+    arguments:      as cryo_radio_send_packet_v2()
+    returns:        number of bytes transmitted, or 0 if the reading was only stored
+*/
+int32_t cryo_radio_batch_add(int16_t ds18b20_temp, int32_t pt1000_temp, int16_t raw_adc_value);
+
+/*
+    name:           cryo_radio_batch_poll()
+    description:    sends the batch if its oldest reading has reached the configured
+                    age, e.g. from an RTC alarm
+    arguments:      none
+    returns:        size of the frame transmitted, or 0 if nothing was sent
+*/
+int32_t cryo_radio_batch_poll();
+
+/*
+    name:           cryo_radio_batch_flush()
+    description:    sends any readings held in the batch
+    arguments:      none
+    returns:        size of the frame transmitted, or 0 if the batch was empty
+*/
+int32_t cryo_radio_batch_flush();
+
+/*
+    name:           cryo_radio_batch_set_compression(bool compress)
+    description:    selects whether batches are sent delta compressed, which fits
+                    several times more readings in each frame.  Any readings 
+                    waiting are sent first.
+    arguments:      compress
+                        - true to send CRYO_RADIO_PACKET_TYPE_BATCH_DELTA frames
+    returns:        none
+*/
+void cryo_radio_batch_set_compression(bool compress);
+
+/*
+    name:           cryo_radio_batch_count()
+    description:    returns the number of readings waiting in the batch
+    arguments:      none
+    returns:        number of readings
+*/
+uint8_t cryo_radio_batch_count();
+
+/*
+    name:           cryo_radio_decode_batch(const uint8_t* buffer, uint8_t length, cryo_radio_packet_v2* packets, uint8_t max_packets)
+    description:    unpacks a received batch frame (compressed or not) into v2 packets
+    arguments:      buffer
+                        - pointer to the received frame
+                    length
+                        - length of the received frame
+                    packets
+                        - pointer to an array of packets to fill in
+                    max_packets
+                        - length of the packets array
+    returns:        number of packets decoded, 0 if the frame isn't a batch
+*/
+uint8_t cryo_radio_decode_batch(const uint8_t* buffer, uint8_t length, cryo_radio_packet_v2* packets, uint8_t max_packets);
+
+/*
+    name:           cryo_radio_rx_start()
+    description:    (gateway) switches on the radio and starts receiving into the 
+                    ring of buffers from the RxDone interrupt, so frames that 
+                    arrive while the main loop is busy (e.g. writing to the SD 
+                    card) are kept.  While it runs, frames should be read with 
+                    cryo_radio_rx_peek() rather than cryo_radio_receive_frame() 
+                    or cryo_radio_receive_packet().
+    example:
+                    cryo_radio_rx_start();
+
+                    // in loop()
+                    cryo_radio_rx_frame* frame;
+                    while ((frame = cryo_radio_rx_peek()) != NULL) {
+                        log_frame(frame->data, frame->length, frame->rssi);
+                        cryo_radio_rx_release();
+                    }
+
+    arguments:      none
+    returns:        none
+*/
+void cryo_radio_rx_start();
+
+/*
+    name:           cryo_radio_rx_stop()
+    description:    (gateway) stops receiving into the ring, leaving the radio idle
+    arguments:      none
+    returns:        none
+*/
+void cryo_radio_rx_stop();
+
+/*
+    name:           cryo_radio_rx_peek()
+    description:    (gateway) returns the oldest received frame in place.  The 
+                    buffer stays valid until cryo_radio_rx_release() is called.
+    arguments:      none
+    returns:        pointer to the frame, or NULL if none are waiting
+*/
+cryo_radio_rx_frame* cryo_radio_rx_peek();
+
+/*
+    name:           cryo_radio_rx_release()
+    description:    (gateway) frees the oldest received frame's buffer for reuse
+    arguments:      none
+    returns:        none
+*/
+void cryo_radio_rx_release();
+
+/*
+    name:           cryo_radio_rx_count()
+    description:    (gateway) returns the number of received frames waiting
+    arguments:      none
+    returns:        number of frames
+*/
+uint8_t cryo_radio_rx_count();
+
+/*
+    name:           cryo_radio_rx_get_stats(cryo_radio_rx_stats* stats)
+    description:    (gateway) copies the receive counters
+    arguments:      stats
+                        - pointer to the counters to fill in
+    returns:        none
+*/
+void cryo_radio_rx_get_stats(cryo_radio_rx_stats* stats);
+
 int32_t cryo_radio_receive_packet(cryo_radio_packet* packet);
 int32_t cryo_radio_receive_packet(cryo_radio_packet* packet, int32_t* rssi);
 
@@ -33,6 +33,7 @@ SOFTWARE.
 
 PseudoRTC cryo_rtc;
 volatile boolean cryo_asleep_flag_debug = false;
+bool cryo_standby_clock_configured = false;
 
 PseudoRTC::PseudoRTC() {
     // Initialise all alarms
@@ -99,6 +100,28 @@ PseudoRTC::time PseudoRTC::get_time () {
     return this->rtc_time;
 }
 
+uint32_t PseudoRTC::get_epoch() {
+
+    PseudoRTC::time t = this->get_time();
+
+    // Days since 1 Jan 1970 from the civil date, counting years from March
+    // so the leap day falls at the end of the year
+    // source: https://howardhinnant.github.io/date_algorithms.html#days_from_civil
+    // (months are 0-based in PseudoRTC)
+    int32_t y = (int32_t) t.year - (t.month < 2);
+    uint32_t m = t.month + 1;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t year_of_era = (uint32_t) (y - era * 400);
+    uint32_t day_of_year = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + t.day - 1;
+    uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int32_t days = era * 146097 + (int32_t) day_of_era - 719468;
+
+    if (days < 0)
+        return 0;
+    return (uint32_t) days * 86400 + t.hour * 3600 + t.minute * 60 + t.second;
+
+}
+
 void PseudoRTC::set_time(PseudoRTC::time time) {
     this->rtc_time = time;
 }
@@ -136,11 +159,23 @@ bool PseudoRTC::is_leap_year(PseudoRTC::time time) {
 void PseudoRTC::check_alarms() {
 
     // this function should be called every tick()
+    uint32_t epoch = 0;
+    for (uint8_t k = 0; k < MAX_RTC_ALARMS; k++) {
+        if (this->alarm_callback[k] != NULL && this->alarm_offsets[k] != RTC_ALARM_UNALIGNED) {
+            epoch = this->get_epoch();
+            break;
+        }
+    }
 
     // Update alarms
     for (uint8_t k = 0; k < MAX_RTC_ALARMS; k++) {
+        // aligned alarms follow the clock, so they stay in step with other
+        // loggers even if the time is changed
+        if (this->alarm_callback[k] != NULL && this->alarm_offsets[k] != RTC_ALARM_UNALIGNED) {
+            if (epoch % this->alarm_intervals[k] == this->alarm_offsets[k])
+                this->alarm_flags[k] = 1;
         //  check if alarm is null-ptr
-        if (this->alarm_callback[k] != NULL) {
+        } else if (this->alarm_callback[k] != NULL) {
             // increment count
             this->alarm_counts[k]++;
             // check against interval
@@ -176,6 +211,7 @@ uint8_t PseudoRTC::add_alarm_every_n_seconds(uint32_t interval, void (*callback)
             this->alarm_intervals[k] = interval;
             this->alarm_counts[k] = 0;
             this->alarm_flags[k] = 0;
+            this->alarm_offsets[k] = RTC_ALARM_UNALIGNED;
             return k;
         }
     }
@@ -184,6 +220,18 @@ uint8_t PseudoRTC::add_alarm_every_n_seconds(uint32_t interval, void (*callback)
 
 }
 
+uint8_t PseudoRTC::add_alarm_aligned(uint32_t interval, uint32_t offset, void (*callback)()) {
+
+    if (interval == 0)
+        return 0xff;
+
+    uint8_t alarm_id = this->add_alarm_every_n_seconds(interval, callback);
+    if (alarm_id != 0xff)
+        this->alarm_offsets[alarm_id] = offset % interval;
+    return alarm_id;
+
+}
+
 void PseudoRTC::remove_alarm(uint8_t alarm_id) {
     
     // don't do anything if the alarm_id is invalid 
@@ -195,6 +243,7 @@ void PseudoRTC::remove_alarm(uint8_t alarm_id) {
     this->alarm_flags[alarm_id] = 0;
     this->alarm_intervals[alarm_id] = 0;
     this->alarm_counts[alarm_id] = 0;
+    this->alarm_offsets[alarm_id] = RTC_ALARM_UNALIGNED;
 
 }
 
@@ -282,6 +331,12 @@ void cryo_add_alarm_every(uint32_t seconds, void (*callback)()) {
 
 }
 
+uint8_t cryo_add_alarm_aligned(uint32_t seconds, uint32_t offset, void (*callback)()) {
+
+    return cryo_rtc.add_alarm_aligned(seconds, offset, callback);
+
+}
+
 void cryo_sleep() {
 
     #ifdef CRYO_SLEEP_MODE_DEBUG
@@ -306,6 +361,45 @@ void cryo_sleep_debug() {
     while (cryo_asleep_flag_debug) {}; 
 }; // do nothing
 
+void cryo_standby_clock_attach(uint8_t clock_id) {
+
+    if (!cryo_standby_clock_configured) {
+        // Let OSC8M run in standby, but only while a peripheral requests it
+        SYSCTRL->OSC8M.reg |= SYSCTRL_OSC8M_RUNSTDBY | SYSCTRL_OSC8M_ONDEMAND;
+
+        GCLK->GENDIV.reg = 
+            GCLK_GENDIV_ID(CRYO_STANDBY_GCLK) |
+            GCLK_GENDIV_DIV(1);
+        while (GCLK->STATUS.bit.SYNCBUSY);
+
+        GCLK->GENCTRL.reg = 
+            GCLK_GENCTRL_ID(CRYO_STANDBY_GCLK) |
+            GCLK_GENCTRL_SRC_OSC8M |
+            GCLK_GENCTRL_RUNSTDBY |
+            GCLK_GENCTRL_GENEN;
+        while (GCLK->STATUS.bit.SYNCBUSY);
+
+        cryo_standby_clock_configured = true;
+    }
+
+    GCLK->CLKCTRL.reg = 
+        GCLK_CLKCTRL_ID(clock_id) |
+        GCLK_CLKCTRL_GEN(CRYO_STANDBY_GCLK) |
+        GCLK_CLKCTRL_CLKEN;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+}
+
+void cryo_standby_clock_detach(uint8_t clock_id) {
+
+    GCLK->CLKCTRL.reg = 
+        GCLK_CLKCTRL_ID(clock_id) |
+        GCLK_CLKCTRL_GEN_GCLK0 |
+        GCLK_CLKCTRL_CLKEN;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+}
+
 void cryo_rtc_handler() {
     
     // Perform RTC tick
@@ -92,6 +92,18 @@ EXAMPLE USAGE:
 #define MAX_RTC_ALARMS 4
 #define CRYO_SLEEP_INTERVAL_SECONDS 1
 #define CRYO_RTC_TIMESTAMP_LENGTH 24
+#define RTC_ALARM_UNALIGNED 0xffffffff
+
+/*
+    Standby Clock Generator
+    -----------------------
+    Generic clock generator used by cryo_standby_clock_attach() to keep 
+    peripherals clocked during sleep.  Can be defined prior to including
+    cryo_sleep.h if generator 4 is already in use.
+*/
+#ifndef CRYO_STANDBY_GCLK
+#define CRYO_STANDBY_GCLK 4
+#endif
 
 // ** IMPORTANT ** 
 // Comment out this line to ENABLE true sleep mode!
@@ -181,6 +193,46 @@ void cryo_sleep_debug();
 */
 void cryo_add_alarm_every(uint32_t seconds, void (*callback)());
 
+/*
+    name:           cryo_add_alarm_aligned(uint32_t seconds, uint32_t offset, void (*callback)())
+    description:    adds an alarm function that is called whenever the time, as seconds since 
+                    1970 (PseudoRTC::get_epoch()), is 'offset' seconds into a multiple of 
+                    'seconds'.  Unlike cryo_add_alarm_every(), the alarm doesn't depend on 
+                    when the logger started, so loggers with the same time raise their 
+                    alarms together (or, with different offsets, take turns).
+    example:        
+                    // every 10 minutes, at 2 minutes past
+                    cryo_add_alarm_aligned(600, 120, my_alarm_function);
+
+    arguments:      uint32_t seconds    - interval between alarms in seconds,
+                    uint32_t offset     - offset into the interval in seconds,
+                    void (*callback)()  - pointer to the callback function to be associated with this alarm
+    returns:        alarm_id, or 0xff if there are no free alarms
+*/
+uint8_t cryo_add_alarm_aligned(uint32_t seconds, uint32_t offset, void (*callback)());
+
+/*
+    name:           cryo_standby_clock_attach(uint8_t clock_id)
+    description:    routes the generic clock of a peripheral to a generator (CRYO_STANDBY_GCLK)
+                    that keeps running during cryo_sleep(), so the peripheral can operate 
+                    while the processor sleeps.  The generator is driven by OSC8M in 
+                    on-demand mode, so it only draws power while the peripheral needs it.
+    example:        
+                    cryo_standby_clock_attach(GCLK_CLKCTRL_ID_ADC);
+
+    arguments:      uint8_t clock_id    - generic clock ID of the peripheral (GCLK_CLKCTRL_ID_*)
+    returns:        none
+*/
+void cryo_standby_clock_attach(uint8_t clock_id);
+
+/*
+    name:           cryo_standby_clock_detach(uint8_t clock_id)
+    description:    returns the generic clock of a peripheral to the main clock (GCLK0)
+    arguments:      uint8_t clock_id    - generic clock ID of the peripheral (GCLK_CLKCTRL_ID_*)
+    returns:        none
+*/
+void cryo_standby_clock_detach(uint8_t clock_id);
+
 /*
     name:           cryo_rtc_handler()
     description:    called every second to update the real-time clock, shouldn't need to be used
@@ -228,6 +280,10 @@ class PseudoRTC {
         // adds an alarm function (callback) to be called every 'interval' seconds
         // returns the alarm_id that has been assigned
         uint8_t add_alarm_every_n_seconds(uint32_t interval, void (*callback)());
+        // adds an alarm function (callback) to be called when the epoch time is
+        // 'offset' seconds into a multiple of 'interval' seconds
+        // returns the alarm_id that has been assigned
+        uint8_t add_alarm_aligned(uint32_t interval, uint32_t offset, void (*callback)());
         // removes the alarm assigned at alarm_id 
         void remove_alarm(uint8_t alarm_id);
 
@@ -255,6 +311,9 @@ class PseudoRTC {
             
         */
         uint8_t get_timestamp(char* str);
+        // returns the current time as seconds since 00:00:00 1 Jan 1970 (Unix time),
+        // or 0 if the time is before 1970
+        uint32_t get_epoch();
         // sets the time held in the PseudoRTC
         void set_time(PseudoRTC::time time);
         // updates the time in the PseudoRTC from __DATE__ and __TIME__ compile strings
@@ -272,6 +331,8 @@ class PseudoRTC {
         uint32_t alarm_intervals[MAX_RTC_ALARMS];
         uint32_t alarm_counts[MAX_RTC_ALARMS];
         uint8_t alarm_flags[MAX_RTC_ALARMS];
+        // offset of aligned alarms, or RTC_ALARM_UNALIGNED
+        uint32_t alarm_offsets[MAX_RTC_ALARMS];
         void (*alarm_callback[MAX_RTC_ALARMS])();
 
         const uint8_t DAYS_OF_MONTH[12] = {